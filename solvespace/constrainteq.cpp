@@ -9,6 +9,58 @@
 
 const hConstraint ConstraintBase::NO_CONSTRAINT = { 0 };
 
+//-----------------------------------------------------------------------------
+// Index the point-coincident constraints in group hg by their two points.
+//-----------------------------------------------------------------------------
+static int ComparePointPairs(const void *va, const void *vb) {
+    PointPair *a = (PointPair *)va, *b = (PointPair *)vb;
+    if(a->a.v != b->a.v) return (a->a.v < b->a.v) ? -1 : 1;
+    if(a->b.v != b->b.v) return (a->b.v < b->b.v) ? -1 : 1;
+    return 0;
+}
+
+void CoincidentIndex::Build(hGroup hg) {
+    Clear();
+
+    int i;
+    for(i = 0; i < SK.constraint.n; i++) {
+        ConstraintBase *c = &(SK.constraint.elem[i]);
+        if(c->group.v != hg.v) continue;
+        if(c->type != Constraint::POINTS_COINCIDENT) continue;
+
+        PointPair pp;
+        pp.a = (c->ptA.v < c->ptB.v) ? c->ptA : c->ptB;
+        pp.b = (c->ptA.v < c->ptB.v) ? c->ptB : c->ptA;
+        pair.Add(&pp);
+    }
+    if(pair.n > 1) {
+        qsort(pair.elem, pair.n, sizeof(pair.elem[0]), ComparePointPairs);
+    }
+}
+
+bool CoincidentIndex::Contains(hEntity a, hEntity b) {
+    PointPair pp;
+    pp.a = (a.v < b.v) ? a : b;
+    pp.b = (a.v < b.v) ? b : a;
+
+    int first = 0, last = pair.n - 1;
+    while(first <= last) {
+        int mid = (first + last)/2;
+        int c = ComparePointPairs(&pp, &(pair.elem[mid]));
+        if(c == 0) return true;
+        if(c < 0) {
+            last = mid - 1;
+        } else {
+            first = mid + 1;
+        }
+    }
+    return false;
+}
+
+void CoincidentIndex::Clear(void) {
+    pair.Clear();
+}
+
 bool ConstraintBase::HasLabel(void) {
     switch(type) {
         case PT_LINE_DISTANCE:
@@ -201,13 +253,349 @@ void ConstraintBase::AddEq(IdList<Equation,hEquation> *l, Expr *expr, int index)
     l->Add(&eq);
 }
 
+//-----------------------------------------------------------------------------
+// A cache of the equations for each shape of constraint, kept across solves.
+// The shape is the constraint's type and flags, and the types of all the
+// entities that it refers to (directly, or through their points, normals,
+// and workplanes), along with which of those entities and params are the
+// same. Two constraints with the same shape generate the same expressions
+// apart from their params and valA, so we can build those expressions from
+// a template instead of generating them again.
+//-----------------------------------------------------------------------------
+#define MAX_TEMPLATES           1024
+#define MAX_TEMPLATE_SIG        256
+#define MAX_TEMPLATE_ENTITIES   32
+#define MAX_TEMPLATE_PARAMS     96
+
+// A valA that nothing would ever really use, so that we can find where the
+// valA ended up in the template.
+static const double TEMPLATE_VALA = 1.2345678901234567e-250;
+
+typedef struct {
+    int         op;
+    int         a, b;   // children, as indices in to node[]
+    int         param;  // a PARAM, as an index in to the shape's params
+    bool        isValA; // a CONSTANT that's the constraint's valA
+    double      v;      // or any other CONSTANT
+} TemplateNode;
+
+typedef struct {
+    DWORD           hash;
+    int            *sig;
+    int             sigLen;
+    // Whether the equations can really be built from this template; if
+    // not, we remember that so we don't keep trying.
+    bool            usable;
+
+    TemplateNode   *node;
+    int             nodes;
+    int            *eqIndex;
+    int            *eqRoot;
+    int             eqs;
+} EquationTemplate;
+
+static EquationTemplate *Templates[MAX_TEMPLATES];
+static int TemplatesUsed;
+
+typedef struct {
+    int         sig[MAX_TEMPLATE_SIG];
+    int         sigLen;
+    hEntity     entity[MAX_TEMPLATE_ENTITIES];
+    int         entities;
+    hParam      param[MAX_TEMPLATE_PARAMS];
+    int         params;
+    bool        overflow;
+} TemplateShape;
+
+static void AddToShape(TemplateShape *s, int v) {
+    if(s->sigLen >= MAX_TEMPLATE_SIG) {
+        s->overflow = true;
+        return;
+    }
+    s->sig[(s->sigLen)++] = v;
+}
+
+static void AddEntityToShape(TemplateShape *s, hEntity he, hGroup hg) {
+    if(he.v == 0) {
+        AddToShape(s, -1);
+        return;
+    }
+    int i;
+    for(i = 0; i < s->entities; i++) {
+        if(s->entity[i].v == he.v) {
+            // Seen already, so just note that it's the same one.
+            AddToShape(s, i);
+            return;
+        }
+    }
+    if(s->entities >= MAX_TEMPLATE_ENTITIES) {
+        s->overflow = true;
+        return;
+    }
+    s->entity[(s->entities)++] = he;
+    AddToShape(s, -2);
+
+    EntityBase *e = SK.GetEntity(he);
+    switch(e->type) {
+        // Only the entities whose expressions are made entirely of their
+        // params; the others (like a copied point) bake numbers in.
+        case EntityBase::POINT_IN_3D:
+        case EntityBase::POINT_IN_2D:
+        case EntityBase::NORMAL_IN_3D:
+        case EntityBase::NORMAL_IN_2D:
+        case EntityBase::DISTANCE:
+        case EntityBase::WORKPLANE:
+        case EntityBase::LINE_SEGMENT:
+        case EntityBase::CUBIC:
+        case EntityBase::CUBIC_PERIODIC:
+        case EntityBase::CIRCLE:
+        case EntityBase::ARC_OF_CIRCLE:
+            break;
+
+        default:
+            s->overflow = true;
+            return;
+    }
+    AddToShape(s, e->type);
+    AddToShape(s, e->extraPoints);
+    AddToShape(s, (e->group.v == hg.v) ? 1 : 0);
+
+    for(i = 0; i < (int)arraylen(e->param); i++) {
+        if(e->param[i].v == 0) {
+            AddToShape(s, -1);
+            continue;
+        }
+        int j;
+        for(j = 0; j < s->params; j++) {
+            if(s->param[j].v == e->param[i].v) break;
+        }
+        if(j == s->params) {
+            if(s->params >= MAX_TEMPLATE_PARAMS) {
+                s->overflow = true;
+                return;
+            }
+            s->param[(s->params)++] = e->param[i];
+        }
+        AddToShape(s, j);
+    }
+
+    for(i = 0; i < MAX_POINTS_IN_ENTITY; i++) {
+        AddEntityToShape(s, e->point[i], hg);
+    }
+    AddEntityToShape(s, e->normal, hg);
+    AddEntityToShape(s, e->distance, hg);
+    AddEntityToShape(s, e->workplane, hg);
+}
+
+static int FlattenForTemplate(List<Expr *> *seen, List<TemplateNode> *node,
+                              TemplateShape *s, Expr *e)
+{
+    int i;
+    for(i = 0; i < seen->n; i++) {
+        if(seen->elem[i] == e) return i;
+    }
+
+    TemplateNode tn;
+    ZERO(&tn);
+    tn.op = e->op;
+    tn.a = tn.b = -1;
+    switch(e->op) {
+        case Expr::PARAM:
+            for(i = 0; i < s->params; i++) {
+                if(s->param[i].v == e->x.parh.v) break;
+            }
+            if(i == s->params) return -1;
+            tn.param = i;
+            break;
+
+        case Expr::CONSTANT:
+            if(e->x.v == TEMPLATE_VALA) {
+                tn.isValA = true;
+            } else {
+                tn.v = e->x.v;
+            }
+            break;
+
+        case Expr::PARAM_PTR:
+            return -1;
+
+        default:
+            tn.a = FlattenForTemplate(seen, node, s, e->a);
+            if(tn.a < 0) return -1;
+            if(e->Children() >= 2) {
+                tn.b = FlattenForTemplate(seen, node, s, e->b);
+                if(tn.b < 0) return -1;
+            }
+            break;
+    }
+    seen->Add(&e);
+    node->Add(&tn);
+    return node->n - 1;
+}
+
+//-----------------------------------------------------------------------------
+// Whether the equations that we write depend on the current values of the
+// params (or on valA), beyond just referring to them; if so, then they're
+// good only for those values, and must be written again if they change.
+//-----------------------------------------------------------------------------
+bool ConstraintBase::EquationsDependOnValues(void) {
+    switch(type) {
+        // These pick which components to write from the current vectors.
+        case PT_ON_LINE:
+        case PARALLEL:
+        case CUBIC_LINE_TANGENT:
+            return (workplane.v == EntityBase::FREE_IN_3D.v);
+
+        case SAME_ORIENTATION:
+        case EQUAL_LINE_ARC_LEN:
+        case WHERE_DRAGGED:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Generate our equations from the cached template for our shape, making
+// that template first if we don't have it yet. Returns false if these
+// equations can't come from a template, so they must be generated the
+// usual way.
+//-----------------------------------------------------------------------------
+bool ConstraintBase::GenerateFromTemplate(IdList<Equation,hEquation> *l) {
+    if(EquationsDependOnValues()) return false;
+    switch(type) {
+        // These look at numbers stored in the entities.
+        case PT_ON_FACE:
+        case PT_FACE_DISTANCE:
+        case COMMENT:
+            return false;
+
+        default:
+            break;
+    }
+
+    TemplateShape s;
+    s.sigLen = s.entities = s.params = 0;
+    s.overflow = false;
+    AddToShape(&s, type);
+    AddToShape(&s, other ? 1 : 0);
+    AddToShape(&s, other2 ? 1 : 0);
+    AddEntityToShape(&s, workplane, group);
+    AddEntityToShape(&s, ptA, group);
+    AddEntityToShape(&s, ptB, group);
+    AddEntityToShape(&s, entityA, group);
+    AddEntityToShape(&s, entityB, group);
+    AddEntityToShape(&s, entityC, group);
+    AddEntityToShape(&s, entityD, group);
+    if(s.overflow) return false;
+
+    int i;
+    DWORD hash = 2166136261u;
+    for(i = 0; i < s.sigLen; i++) {
+        hash = (hash ^ (DWORD)s.sig[i])*16777619;
+    }
+
+    int slot = (int)(hash & (MAX_TEMPLATES - 1));
+    EquationTemplate *t;
+    for(;;) {
+        t = Templates[slot];
+        if(!t) break;
+        if(t->hash == hash && t->sigLen == s.sigLen &&
+           memcmp(t->sig, s.sig, s.sigLen*sizeof(int)) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & (MAX_TEMPLATES - 1);
+    }
+
+    if(!t) {
+        // Keep the table at most half full, so that the probes are short;
+        // past that, just generate the equations the usual way.
+        if(TemplatesUsed >= MAX_TEMPLATES/2) return false;
+
+        IdList<Equation,hEquation> gl;
+        ZERO(&gl);
+        double vprev = valA;
+        hParam pprev = valAParam;
+        valA = TEMPLATE_VALA;
+        valAParam.v = 0;
+        GenerateReal(&gl);
+        valA = vprev;
+        valAParam = pprev;
+
+        List<Expr *> seen;
+        List<TemplateNode> node;
+        ZERO(&seen);
+        ZERO(&node);
+
+        t = (EquationTemplate *)MemAlloc(sizeof(*t));
+        t->hash = hash;
+        t->sigLen = s.sigLen;
+        t->sig = (int *)MemAlloc(s.sigLen*sizeof(int));
+        memcpy(t->sig, s.sig, s.sigLen*sizeof(int));
+        t->eqs = gl.n;
+        t->eqIndex = (int *)MemAlloc(max(gl.n, 1)*sizeof(int));
+        t->eqRoot = (int *)MemAlloc(max(gl.n, 1)*sizeof(int));
+        t->usable = true;
+        for(i = 0; i < gl.n; i++) {
+            t->eqIndex[i] = (int)(gl.elem[i].h.v & 0xffff);
+            t->eqRoot[i] = FlattenForTemplate(&seen, &node, &s, gl.elem[i].e);
+            if(t->eqRoot[i] < 0) t->usable = false;
+        }
+        t->nodes = node.n;
+        t->node = (TemplateNode *)MemAlloc(max(node.n, 1)*sizeof(TemplateNode));
+        memcpy(t->node, node.elem, node.n*sizeof(TemplateNode));
+
+        seen.Clear();
+        node.Clear();
+        gl.Clear();
+
+        Templates[slot] = t;
+        TemplatesUsed++;
+    }
+    if(!t->usable) return false;
+
+    // Build all the nodes in one allocation, straight from the template.
+    Expr *n = (Expr *)AllocTemporary(max(t->nodes, 1)*sizeof(Expr));
+    for(i = 0; i < t->nodes; i++) {
+        TemplateNode *tn = &(t->node[i]);
+        Expr *e = &(n[i]);
+        e->marker = 0;
+        e->op = tn->op;
+        switch(tn->op) {
+            case Expr::PARAM:
+                e->x.parh = s.param[tn->param];
+                break;
+
+            case Expr::CONSTANT:
+                if(tn->isValA && valAParam.v) {
+                    e->op = Expr::PARAM;
+                    e->x.parh = valAParam;
+                } else {
+                    e->x.v = tn->isValA ? valA : tn->v;
+                }
+                break;
+
+            default:
+                e->a = &(n[tn->a]);
+                e->b = (tn->b >= 0) ? &(n[tn->b]) : NULL;
+                break;
+        }
+    }
+    for(i = 0; i < t->eqs; i++) {
+        AddEq(l, &(n[t->eqRoot[i]]), t->eqIndex[i]);
+    }
+    return true;
+}
+
 void ConstraintBase::Generate(IdList<Equation,hEquation> *l) {
     if(!reference) {
-        GenerateReal(l);
+        if(!GenerateFromTemplate(l)) GenerateReal(l);
     }
 }
 void ConstraintBase::GenerateReal(IdList<Equation,hEquation> *l) {
-    Expr *exA = Expr::From(valA);
+    Expr *exA = valAParam.v ? Expr::From(valAParam) : Expr::From(valA);
 
     switch(type) {
         case PT_PT_DISTANCE:
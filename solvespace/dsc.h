@@ -233,13 +233,8 @@ public:
     int   elemsAllocated;
 
     DWORD MaximumId(void) {
-        DWORD id = 0;
-
-        int i;
-        for(i = 0; i < n; i++) {
-            id = max(id, elem[i].h.v);
-        }
-        return id;
+        // The list is sorted by handle, so that's the last one.
+        return (n > 0) ? elem[n-1].h.v : 0;
     }
 
     H AddAndAssignId(T *t) {
@@ -735,7 +735,9 @@ void EntityBase::AddEq(IdList<Equation,hEquation> *l, Expr *expr, int index) {
     l->Add(&eq);
 }
 
-void EntityBase::GenerateEquations(IdList<Equation,hEquation> *l) {
+void EntityBase::GenerateEquations(IdList<Equation,hEquation> *l,
+                                   CoincidentIndex *coincident)
+{
     switch(type) {
         case NORMAL_IN_3D: {
             ExprQuaternion q = NormalGetExprs();
@@ -751,19 +753,7 @@ void EntityBase::GenerateEquations(IdList<Equation,hEquation> *l) {
             // If the two endpoints of the arc are constrained coincident
             // (to make a complete circle), then our distance constraint
             // would be redundant and therefore overconstrain things.
-            int i;
-            for(i = 0; i < SK.constraint.n; i++) {
-                ConstraintBase *c = &(SK.constraint.elem[i]);
-                if(c->group.v != group.v) continue;
-                if(c->type != Constraint::POINTS_COINCIDENT) continue;
-                
-                if((c->ptA.v == point[1].v && c->ptB.v == point[2].v) || 
-                   (c->ptA.v == point[2].v && c->ptB.v == point[1].v))
-                {
-                    break;
-                }
-            }
-            if(i < SK.constraint.n) break;
+            if(coincident->Contains(point[1], point[2])) break;
 
             Expr *ra = Constraint::Distance(workplane, point[0], point[1]);
             Expr *rb = Constraint::Distance(workplane, point[0], point[2]);
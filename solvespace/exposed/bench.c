@@ -0,0 +1,153 @@
+//-----------------------------------------------------------------------------
+// Replay captured problems (written by Slvs_Solve, if sys.capture is set)
+// through the solver, and report how long they take. For example,
+//
+//     slvs-bench -n 100 captures/
+//
+// solves every capture in that directory 100 times, and prints the latency
+// percentiles for each capture and for all of them together.
+//
+// Copyright 2008-2013 Jonathan Westhues.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "slvs.h"
+
+// Every solve that we've timed, in milliseconds
+double *Times;
+int TimesCount, TimesSpace;
+
+double Milliseconds(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec*1000.0 + tv.tv_usec/1000.0;
+}
+
+int CompareDoubles(const void *a, const void *b)
+{
+    double da = *((double *)a), db = *((double *)b);
+    if(da < db) return -1;
+    if(da > db) return  1;
+    return 0;
+}
+
+// The p-th percentile of the n (sorted) times in t
+double Percentile(double *t, int n, double p)
+{
+    int i = (int)(p*(n - 1) + 0.5);
+    return t[i];
+}
+
+void PrintPercentiles(const char *name, double *t, int n)
+{
+    qsort(t, n, sizeof(double), CompareDoubles);
+    printf("%-32s %8d %10.3f %10.3f %10.3f %10.3f\n", name, n,
+        Percentile(t, n, 0.5), Percentile(t, n, 0.9), Percentile(t, n, 0.99),
+        t[n-1]);
+}
+
+void Replay(const char *filename, int runs)
+{
+    Slvs_System sys;
+    Slvs_hGroup hg;
+    if(!Slvs_ReadCapture(filename, &sys, &hg)) {
+        printf("%-32s can't read\n", filename);
+        return;
+    }
+
+    // The solver writes its answer over the initial guesses, so keep those
+    // to start every run from the same place.
+    double *initial = (double *)malloc((sys.params + 1)*sizeof(double));
+    double *t = (double *)malloc(runs*sizeof(double));
+    int i, r;
+    for(i = 0; i < sys.params; i++) {
+        initial[i] = sys.param[i].val;
+    }
+
+    int faileds = sys.faileds;
+    for(r = 0; r < runs; r++) {
+        for(i = 0; i < sys.params; i++) {
+            sys.param[i].val = initial[i];
+        }
+        sys.faileds = faileds;
+
+        double t0 = Milliseconds();
+        Slvs_Solve(&sys, hg);
+        t[r] = Milliseconds() - t0;
+    }
+
+    char name[1024];
+    const char *base = strrchr(filename, '/');
+    sprintf(name, "%.1000s (%d)", base ? base + 1 : filename, sys.result);
+    PrintPercentiles(name, t, runs);
+
+    if(TimesCount + runs > TimesSpace) {
+        TimesSpace = 2*(TimesCount + runs);
+        Times = (double *)realloc(Times, TimesSpace*sizeof(double));
+    }
+    memcpy(Times + TimesCount, t, runs*sizeof(double));
+    TimesCount += runs;
+
+    free(initial);
+    free(t);
+    Slvs_FreeCapture(&sys);
+}
+
+void ReplayPath(const char *path, int runs)
+{
+    struct stat st;
+    if(stat(path, &st) != 0) {
+        printf("%-32s doesn't exist\n", path);
+        return;
+    }
+    if(!S_ISDIR(st.st_mode)) {
+        Replay(path, runs);
+        return;
+    }
+
+    // Replay the captures in a directory in order by name, so that the
+    // output is comparable from one run of the benchmark to the next.
+    struct dirent **list;
+    int n = scandir(path, &list, NULL, alphasort);
+    int i;
+    for(i = 0; i < n; i++) {
+        char file[2048];
+        sprintf(file, "%.1000s/%.1000s", path, list[i]->d_name);
+        if(stat(file, &st) == 0 && S_ISREG(st.st_mode)) {
+            Replay(file, runs);
+        }
+        free(list[i]);
+    }
+    if(n >= 0) free(list);
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 10;
+    int i = 1;
+    if(i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+        runs = atoi(argv[i + 1]);
+        i += 2;
+    }
+    if(i >= argc || runs < 1) {
+        printf("usage: slvs-bench [-n runs] capture-or-directory...\n");
+        return 1;
+    }
+
+    printf("%-32s %8s %10s %10s %10s %10s\n",
+        "capture (result)", "runs", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for(; i < argc; i++) {
+        ReplayPath(argv[i], runs);
+    }
+    if(TimesCount > 0) {
+        PrintPercentiles("all", Times, TimesCount);
+    }
+    free(Times);
+    return 0;
+}
@@ -0,0 +1,231 @@
+//-----------------------------------------------------------------------------
+// Save an Slvs_System to a file, and read it back, so that a problem from
+// someone else's program can be reproduced (or benchmarked) without their
+// program.
+//
+// The file is a header, followed by the params, the entities, and the
+// constraints. Every handle, type, and count is written as four bytes,
+// least significant first, and every double as eight bytes, in the same
+// byte order; so the files don't depend on the size of a long or on how
+// the compiler pads our structs.
+//
+// Copyright 2008-2013 Jonathan Westhues.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "solvespace.h"
+#define EXPORT_DLL
+#include "slvs.h"
+
+#define CAPTURE_MAGIC       "SLVS"
+#define CAPTURE_VERSION     1
+
+static void WriteDword(FILE *f, DWORD v) {
+    BYTE b[4];
+    int i;
+    for(i = 0; i < 4; i++) {
+        b[i] = (BYTE)(v >> (8*i));
+    }
+    fwrite(b, 1, 4, f);
+}
+
+static void WriteDouble(FILE *f, double v) {
+    QWORD q;
+    memcpy(&q, &v, 8);
+    WriteDword(f, (DWORD)(q & 0xffffffff));
+    WriteDword(f, (DWORD)(q >> 32));
+}
+
+static DWORD ReadDword(FILE *f, bool *ok) {
+    BYTE b[4];
+    if(fread(b, 1, 4, f) != 4) {
+        *ok = false;
+        return 0;
+    }
+    return  ((DWORD)b[0])        | ((DWORD)b[1] <<  8) |
+            ((DWORD)b[2] << 16)  | ((DWORD)b[3] << 24);
+}
+
+static double ReadDouble(FILE *f, bool *ok) {
+    QWORD lo = ReadDword(f, ok),
+          hi = ReadDword(f, ok);
+    QWORD q = lo | (hi << 32);
+    double v;
+    memcpy(&v, &q, 8);
+    return v;
+}
+
+extern "C" {
+
+int Slvs_WriteCapture(Slvs_System *ssys, Slvs_hGroup shg,
+                      const char *filename)
+{
+    FILE *f = fopen(filename, "wb");
+    if(!f) {
+        dbp("can't write capture '%s'", filename);
+        return 0;
+    }
+
+    int i, j;
+    fwrite(CAPTURE_MAGIC, 1, 4, f);
+    WriteDword(f, CAPTURE_VERSION);
+    WriteDword(f, shg);
+    WriteDword(f, ssys->calculateFaileds);
+    for(i = 0; i < 4; i++) {
+        WriteDword(f, ssys->dragged[i]);
+    }
+    WriteDword(f, ssys->params);
+    WriteDword(f, ssys->entities);
+    WriteDword(f, ssys->constraints);
+
+    for(i = 0; i < ssys->params; i++) {
+        Slvs_Param *p = &(ssys->param[i]);
+        WriteDword(f, p->h);
+        WriteDword(f, p->group);
+        WriteDouble(f, p->val);
+    }
+    for(i = 0; i < ssys->entities; i++) {
+        Slvs_Entity *e = &(ssys->entity[i]);
+        WriteDword(f, e->h);
+        WriteDword(f, e->group);
+        WriteDword(f, e->type);
+        WriteDword(f, e->wrkpl);
+        for(j = 0; j < 4; j++) WriteDword(f, e->point[j]);
+        WriteDword(f, e->normal);
+        WriteDword(f, e->distance);
+        for(j = 0; j < 4; j++) WriteDword(f, e->param[j]);
+    }
+    for(i = 0; i < ssys->constraints; i++) {
+        Slvs_Constraint *c = &(ssys->constraint[i]);
+        WriteDword(f, c->h);
+        WriteDword(f, c->group);
+        WriteDword(f, c->type);
+        WriteDword(f, c->wrkpl);
+        WriteDouble(f, c->valA);
+        WriteDword(f, c->ptA);
+        WriteDword(f, c->ptB);
+        WriteDword(f, c->entityA);
+        WriteDword(f, c->entityB);
+        WriteDword(f, c->entityC);
+        WriteDword(f, c->entityD);
+        WriteDword(f, c->other);
+        WriteDword(f, c->other2);
+    }
+
+    bool ok = (ferror(f) == 0);
+    if(fclose(f) != 0) ok = false;
+    return ok ? 1 : 0;
+}
+
+int Slvs_ReadCapture(const char *filename, Slvs_System *ssys,
+                     Slvs_hGroup *shg)
+{
+    FILE *f = fopen(filename, "rb");
+    if(!f) {
+        dbp("can't read capture '%s'", filename);
+        return 0;
+    }
+
+    memset(ssys, 0, sizeof(*ssys));
+
+    bool ok = true;
+    int i, j;
+    char magic[4];
+    if(fread(magic, 1, 4, f) != 4 || memcmp(magic, CAPTURE_MAGIC, 4) != 0) {
+        dbp("'%s' isn't a capture", filename);
+        fclose(f);
+        return 0;
+    }
+    DWORD version = ReadDword(f, &ok);
+    if(!ok || version != CAPTURE_VERSION) {
+        dbp("capture '%s' has unknown version %d", filename, (int)version);
+        fclose(f);
+        return 0;
+    }
+    *shg = ReadDword(f, &ok);
+    ssys->calculateFaileds = (int)ReadDword(f, &ok);
+    for(i = 0; i < 4; i++) {
+        ssys->dragged[i] = ReadDword(f, &ok);
+    }
+    int params      = (int)ReadDword(f, &ok),
+        entities    = (int)ReadDword(f, &ok),
+        constraints = (int)ReadDword(f, &ok);
+    if(!ok || params < 0 || entities < 0 || constraints < 0) {
+        dbp("capture '%s' is truncated", filename);
+        fclose(f);
+        return 0;
+    }
+
+    ssys->param      = (Slvs_Param *)calloc(max(params, 1),
+                                            sizeof(Slvs_Param));
+    ssys->entity     = (Slvs_Entity *)calloc(max(entities, 1),
+                                             sizeof(Slvs_Entity));
+    ssys->constraint = (Slvs_Constraint *)calloc(max(constraints, 1),
+                                                 sizeof(Slvs_Constraint));
+    ssys->failed     = (Slvs_hConstraint *)calloc(max(constraints, 1),
+                                                  sizeof(Slvs_hConstraint));
+    if(!(ssys->param && ssys->entity && ssys->constraint && ssys->failed)) {
+        Slvs_FreeCapture(ssys);
+        fclose(f);
+        return 0;
+    }
+    ssys->faileds = constraints;
+
+    for(i = 0; i < params && ok; i++) {
+        Slvs_Param *p = &(ssys->param[i]);
+        p->h     = ReadDword(f, &ok);
+        p->group = ReadDword(f, &ok);
+        p->val   = ReadDouble(f, &ok);
+        ssys->params++;
+    }
+    for(i = 0; i < entities && ok; i++) {
+        Slvs_Entity *e = &(ssys->entity[i]);
+        e->h        = ReadDword(f, &ok);
+        e->group    = ReadDword(f, &ok);
+        e->type     = (int)ReadDword(f, &ok);
+        e->wrkpl    = ReadDword(f, &ok);
+        for(j = 0; j < 4; j++) e->point[j] = ReadDword(f, &ok);
+        e->normal   = ReadDword(f, &ok);
+        e->distance = ReadDword(f, &ok);
+        for(j = 0; j < 4; j++) e->param[j] = ReadDword(f, &ok);
+        ssys->entities++;
+    }
+    for(i = 0; i < constraints && ok; i++) {
+        Slvs_Constraint *c = &(ssys->constraint[i]);
+        c->h        = ReadDword(f, &ok);
+        c->group    = ReadDword(f, &ok);
+        c->type     = (int)ReadDword(f, &ok);
+        c->wrkpl    = ReadDword(f, &ok);
+        c->valA     = ReadDouble(f, &ok);
+        c->ptA      = ReadDword(f, &ok);
+        c->ptB      = ReadDword(f, &ok);
+        c->entityA  = ReadDword(f, &ok);
+        c->entityB  = ReadDword(f, &ok);
+        c->entityC  = ReadDword(f, &ok);
+        c->entityD  = ReadDword(f, &ok);
+        c->other    = (int)ReadDword(f, &ok);
+        c->other2   = (int)ReadDword(f, &ok);
+        ssys->constraints++;
+    }
+    fclose(f);
+
+    if(!ok) {
+        dbp("capture '%s' is truncated", filename);
+        Slvs_FreeCapture(ssys);
+        return 0;
+    }
+    return 1;
+}
+
+void Slvs_FreeCapture(Slvs_System *ssys)
+{
+    free(ssys->param);
+    free(ssys->entity);
+    free(ssys->constraint);
+    free(ssys->failed);
+    memset(ssys, 0, sizeof(*ssys));
+}
+
+}
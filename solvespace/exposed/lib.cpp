@@ -21,58 +21,13 @@ void DoMessageBox(char *str, int rows, int cols, BOOL error)
 {
 }
 
-extern "C" {
-
-void Slvs_QuaternionU(double qw, double qx, double qy, double qz,
-                         double *x, double *y, double *z)
-{
-    Quaternion q = Quaternion::From(qw, qx, qy, qz);
-    Vector v = q.RotationU();
-    *x = v.x;
-    *y = v.y;
-    *z = v.z;
-}
-
-void Slvs_QuaternionV(double qw, double qx, double qy, double qz,
-                         double *x, double *y, double *z)
-{
-    Quaternion q = Quaternion::From(qw, qx, qy, qz);
-    Vector v = q.RotationV();
-    *x = v.x;
-    *y = v.y;
-    *z = v.z;
-}
-
-void Slvs_QuaternionN(double qw, double qx, double qy, double qz,
-                         double *x, double *y, double *z)
-{
-    Quaternion q = Quaternion::From(qw, qx, qy, qz);
-    Vector v = q.RotationN();
-    *x = v.x;
-    *y = v.y;
-    *z = v.z;
-}
-
-void Slvs_MakeQuaternion(double ux, double uy, double uz,
-                         double vx, double vy, double vz,
-                         double *qw, double *qx, double *qy, double *qz)
-{
-    Vector u = Vector::From(ux, uy, uz),
-           v = Vector::From(vx, vy, vz);
-    Quaternion q = Quaternion::From(u, v);
-    *qw = q.w;
-    *qx = q.vx;
-    *qy = q.vy;
-    *qz = q.vz;
-}
-
-void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
+//-----------------------------------------------------------------------------
+// Copy the caller's params, entities, and constraints in to our sketch. This
+// doesn't say anything about which group gets solved; that's up to the
+// caller. Returns false if we don't know some entity or constraint type.
+//-----------------------------------------------------------------------------
+static bool ImportSketch(Slvs_System *ssys)
 {
-    if(!IsInit) {
-        InitHeaps();
-        IsInit = 1;
-    }
-
     int i;
     for(i = 0; i < ssys->params; i++) {
         Slvs_Param *sp = &(ssys->param[i]);
@@ -82,9 +37,6 @@ void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
         p.h.v = sp->h;
         p.val = sp->val;
         SK.param.Add(&p);
-        if(sp->group == shg) {
-            SYS.param.Add(&p);
-        }
     }
 
     for(i = 0; i < ssys->entities; i++) {
@@ -104,7 +56,7 @@ case SLVS_E_CUBIC:              e.type = Entity::CUBIC; break;
 case SLVS_E_CIRCLE:             e.type = Entity::CIRCLE; break;
 case SLVS_E_ARC_OF_CIRCLE:      e.type = Entity::ARC_OF_CIRCLE; break;
 
-default: dbp("bad entity type %d", se->type); return;
+default: dbp("bad entity type %d", se->type); return false;
         }
         e.h.v           = se->h;
         e.group.v       = se->group;
@@ -164,7 +116,7 @@ case SLVS_C_PROJ_PT_DISTANCE:   t = Constraint::PROJ_PT_DISTANCE; break;
 case SLVS_C_WHERE_DRAGGED:      t = Constraint::WHERE_DRAGGED; break;
 case SLVS_C_CURVE_CURVE_TANGENT:t = Constraint::CURVE_CURVE_TANGENT; break;
 
-default: dbp("bad constraint type %d", sc->type); return;
+default: dbp("bad constraint type %d", sc->type); return false;
         }
 
         c.type = t;
@@ -185,45 +137,685 @@ default: dbp("bad constraint type %d", sc->type); return;
         SK.constraint.Add(&c);
     }
 
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Put the params of group shg in to the solver, starting from their current
+// values in the sketch.
+//-----------------------------------------------------------------------------
+static void ImportGroupParams(Slvs_System *ssys, Slvs_hGroup shg)
+{
+    int i;
+    for(i = 0; i < ssys->params; i++) {
+        Slvs_Param *sp = &(ssys->param[i]);
+        if(sp->group != shg) continue;
+
+        hParam hp = { sp->h };
+        Param p;
+        ZERO(&p);
+        p.h = hp;
+        p.val = SK.GetParam(hp)->val;
+        SYS.param.Add(&p);
+    }
+}
+
+static void ImportDragged(Slvs_System *ssys)
+{
+    int i;
     for(i = 0; i < arraylen(ssys->dragged); i++) {
         if(ssys->dragged[i]) {
             hParam hp = { ssys->dragged[i] };
             SYS.dragged.Add(&hp);
         }
     }
+}
+
+//-----------------------------------------------------------------------------
+// Convert one of the System:: results to the SLVS_RESULT_* code.
+//-----------------------------------------------------------------------------
+static int ResultFromSolver(int how)
+{
+    switch(how) {
+        case System::SOLVED_OKAY:           return SLVS_RESULT_OKAY;
+        case System::DIDNT_CONVERGE:        return SLVS_RESULT_DIDNT_CONVERGE;
+        case System::SINGULAR_JACOBIAN:     return SLVS_RESULT_INCONSISTENT;
+        case System::TOO_MANY_UNKNOWNS:     return SLVS_RESULT_TOO_MANY_UNKNOWNS;
+        case System::TIMED_OUT:             return SLVS_RESULT_TIMED_OUT;
 
+        default: oops();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Solve group shg, with the sketch already imported and the group's params
+// already in SYS.param; returns one of the SLVS_RESULT_* codes.
+//-----------------------------------------------------------------------------
+static int SolveGroup(Slvs_hGroup shg, int *dof, List<hConstraint> *bad,
+                      bool andFindBad)
+{
     Group g;
     ZERO(&g);
     g.h.v = shg;
 
+    return ResultFromSolver(SYS.Solve(&g, dof, bad, andFindBad, false));
+}
+
+//-----------------------------------------------------------------------------
+// Start the caller's clock, if they gave us a timeout; it runs until the
+// next call in to the library.
+//-----------------------------------------------------------------------------
+static void StartClock(Slvs_System *ssys)
+{
+    SYS.haveDeadline = (ssys->timeout > 0);
+    SYS.deadline = GetMilliseconds() + ssys->timeout;
+    SYS.cancel = ssys->cancel;
+}
+
+//-----------------------------------------------------------------------------
+// If the caller asked for stats, then point the solver at ours, and convert
+// them to the caller's units once the call is done.
+//-----------------------------------------------------------------------------
+static System::Stats SolveStats;
+static SQWORD StatsStartTime;
+static QWORD StatsStartBytes;
+
+static void StartStats(Slvs_System *ssys)
+{
+    SYS.stats = NULL;
+    if(!ssys->stats) return;
+
+    ZERO(&SolveStats);
+    SolveStats.blockIterations = ssys->stats->blockIteration;
+    SolveStats.blockSpace = ssys->stats->blockIteration ?
+                                ssys->stats->blocks : 0;
+    SYS.stats = &SolveStats;
+
+    StatsStartTime = GetMicroseconds();
+    StatsStartBytes = TemporaryBytesAllocated();
+}
+
+static void FinishStats(Slvs_System *ssys)
+{
+    if(!SYS.stats) return;
+
+    Slvs_Stats *st = ssys->stats;
+    st->generateTime    = SolveStats.generateTime/1000.0;
+    st->substituteTime  = SolveStats.substituteTime/1000.0;
+    st->jacobianTime    = SolveStats.jacobianTime/1000.0;
+    st->rankTime        = SolveStats.rankTime/1000.0;
+    st->newtonTime      = SolveStats.newtonTime/1000.0;
+    st->diagnoseTime    = SolveStats.diagnoseTime/1000.0;
+    st->totalTime       = (GetMicroseconds() - StatsStartTime)/1000.0;
+
+    st->equations       = SolveStats.equations;
+    st->params          = SolveStats.params;
+    st->equationsLeft   = SolveStats.equationsLeft;
+    st->paramsLeft      = SolveStats.paramsLeft;
+    st->exprNodes       = SolveStats.exprNodes;
+
+    st->blocks          = SolveStats.blocks;
+    st->iterations      = SolveStats.iterations;
+
+    st->temporaryBytes  =
+        (double)(TemporaryBytesAllocated() - StatsStartBytes);
+
+    SYS.stats = NULL;
+}
+
+static void ClearSolver(void)
+{
+    SYS.param.Clear();
+    SYS.eq.Clear();
+    SYS.dragged.Clear();
+    FreeAllTemporary();
+}
+
+static void ClearSketch(void)
+{
+    SYS.entity.Clear();
+
+    SK.param.Clear();
+    SK.entity.Clear();
+    SK.constraint.Clear();
+
+    ClearSolver();
+}
+
+//-----------------------------------------------------------------------------
+// Find the order in which to solve all of the caller's groups: each group
+// after every group whose params or entities it uses. Otherwise (and if the
+// groups somehow depend on each other in a cycle), in order of handle.
+// Returns the number of groups, written to order[], which must have space
+// for params + entities + constraints of them.
+//-----------------------------------------------------------------------------
+static int CompareGroupHandles(const void *va, const void *vb) {
+    Slvs_hGroup a = *((Slvs_hGroup *)va), b = *((Slvs_hGroup *)vb);
+    if(a == b) return 0;
+    return (a < b) ? -1 : 1;
+}
+
+static int FindGroup(Slvs_hGroup *group, int groups, Slvs_hGroup hg) {
+    int first = 0, last = groups - 1;
+    while(first <= last) {
+        int mid = (first + last)/2;
+        if(group[mid] == hg) return mid;
+        if(group[mid] < hg) {
+            first = mid + 1;
+        } else {
+            last = mid - 1;
+        }
+    }
+    return -1;
+}
+
+// Note that group a uses something from the group of entity he.
+static void DependsOnEntity(bool *dep, Slvs_hGroup *group, int groups,
+                            int a, hEntity he)
+{
+    if(he.v == 0) return;
+    EntityBase *e = SK.entity.FindByIdNoOops(he);
+    if(!e) return;
+    int b = FindGroup(group, groups, e->group.v);
+    if(b >= 0 && b != a) dep[a*groups + b] = true;
+}
+
+static int OrderGroups(Slvs_System *ssys, Slvs_hGroup *order)
+{
+    int i, j, n = 0;
+    Slvs_hGroup *group = (Slvs_hGroup *)MemAlloc(
+        max(ssys->params + ssys->entities + ssys->constraints, 1)*
+            sizeof(Slvs_hGroup));
+    for(i = 0; i < ssys->params; i++)      group[n++] = ssys->param[i].group;
+    for(i = 0; i < ssys->entities; i++)    group[n++] = ssys->entity[i].group;
+    for(i = 0; i < ssys->constraints; i++) group[n++] = ssys->constraint[i].group;
+    qsort(group, n, sizeof(group[0]), CompareGroupHandles);
+    int groups = 0;
+    for(i = 0; i < n; i++) {
+        if(groups == 0 || group[groups-1] != group[i]) {
+            group[groups++] = group[i];
+        }
+    }
+
+    // dep[a*groups + b] is true if group a uses something from group b. The
+    // params don't know their group once they're in the sketch, so keep
+    // that in their tags for now.
+    bool *dep = (bool *)MemAlloc(max(groups*groups, 1)*sizeof(bool));
+    for(i = 0; i < ssys->params; i++) {
+        hParam hp = { ssys->param[i].h };
+        SK.GetParam(hp)->tag = FindGroup(group, groups, ssys->param[i].group);
+    }
+    for(i = 0; i < SK.entity.n; i++) {
+        EntityBase *e = &(SK.entity.elem[i]);
+        int a = FindGroup(group, groups, e->group.v);
+        for(j = 0; j < 4; j++) {
+            DependsOnEntity(dep, group, groups, a, e->point[j]);
+        }
+        DependsOnEntity(dep, group, groups, a, e->normal);
+        DependsOnEntity(dep, group, groups, a, e->distance);
+        DependsOnEntity(dep, group, groups, a, e->workplane);
+        for(j = 0; j < 4; j++) {
+            if(e->param[j].v == 0) continue;
+            Param *p = SK.param.FindByIdNoOops(e->param[j]);
+            if(p && p->tag != a) dep[a*groups + p->tag] = true;
+        }
+    }
+    for(i = 0; i < SK.constraint.n; i++) {
+        ConstraintBase *c = &(SK.constraint.elem[i]);
+        int a = FindGroup(group, groups, c->group.v);
+        DependsOnEntity(dep, group, groups, a, c->workplane);
+        DependsOnEntity(dep, group, groups, a, c->ptA);
+        DependsOnEntity(dep, group, groups, a, c->ptB);
+        DependsOnEntity(dep, group, groups, a, c->entityA);
+        DependsOnEntity(dep, group, groups, a, c->entityB);
+        DependsOnEntity(dep, group, groups, a, c->entityC);
+        DependsOnEntity(dep, group, groups, a, c->entityD);
+    }
+    SK.param.ClearTags();
+
+    // Now repeatedly take the first group whose dependencies are all done.
+    bool *done = (bool *)MemAlloc(max(groups, 1)*sizeof(bool));
+    int k;
+    for(k = 0; k < groups; k++) {
+        int next = -1, first = -1;
+        for(i = 0; i < groups && next < 0; i++) {
+            if(done[i]) continue;
+            if(first < 0) first = i;
+            for(j = 0; j < groups; j++) {
+                if(dep[i*groups + j] && !done[j]) break;
+            }
+            if(j >= groups) next = i;
+        }
+        if(next < 0) next = first;
+
+        done[next] = true;
+        order[k] = group[next];
+    }
+
+    MemFree(group);
+    MemFree(dep);
+    MemFree(done);
+    return groups;
+}
+
+//-----------------------------------------------------------------------------
+// Move the dimension of constraint c from its current value (at which the
+// sketch is already solved) to target, by predictor-corrector continuation.
+// Each step is predicted along the tangent, then corrected by the usual
+// Newton solve; if that fails, or if the corrector had to go much further
+// than the predictor did (so that we probably jumped to a different
+// branch of the solution), then we back up and try half the step.
+//-----------------------------------------------------------------------------
+static int SweepTo(Slvs_System *ssys, Slvs_hGroup shg, ConstraintBase *c,
+                   Param **sp, double *xk, double *xp, double target,
+                   int *dof)
+{
+    static const int MAX_HALVINGS = 10;
+
+    Group g;
+    ZERO(&g);
+    g.h.v = shg;
+
+    double h = target - c->valA;
+    int halvings = 0;
+    int how = SLVS_RESULT_OKAY;
+    int i;
+    while(c->valA != target) {
+        double vprev = c->valA,
+               vnext = (ffabs(h) >= ffabs(target - vprev)) ? target : vprev+h;
+
+        for(i = 0; i < ssys->params; i++) {
+            xk[i] = sp[i]->val;
+        }
+        ImportGroupParams(ssys, shg);
+        ImportDragged(ssys);
+        bool predicted = SYS.PredictContinuation(&g, c, vnext);
+        if(!predicted) {
+            // Fall back to starting the corrector from the last solution.
+            SYS.param.Clear();
+            ImportGroupParams(ssys, shg);
+        }
+        for(i = 0; i < ssys->params; i++) {
+            hParam hp = { ssys->param[i].h };
+            Param *p = SYS.param.FindByIdNoOops(hp);
+            xp[i] = p ? p->val : xk[i];
+        }
+
+        c->valA = vnext;
+        List<hConstraint> bad;
+        ZERO(&bad);
+        how = SolveGroup(shg, dof, &bad, false);
+        bad.Clear();
+        ClearSolver();
+        if(how == SLVS_RESULT_TIMED_OUT) {
+            // No point in trying a shorter step, we're out of time.
+            c->valA = vprev;
+            return how;
+        }
+
+        bool okay = (how == SLVS_RESULT_OKAY);
+        if(okay && predicted) {
+            double step = 0, corr = 0;
+            for(i = 0; i < ssys->params; i++) {
+                step += (xp[i] - xk[i])*(xp[i] - xk[i]);
+                corr += (sp[i]->val - xp[i])*(sp[i]->val - xp[i]);
+            }
+            if(sqrt(corr) > 0.5*sqrt(step) + LENGTH_EPS) okay = false;
+        }
+
+        if(okay) {
+            // And if that worked, then try a longer step next time.
+            halvings = 0;
+            h = 2*(vnext - vprev);
+        } else {
+            c->valA = vprev;
+            for(i = 0; i < ssys->params; i++) {
+                sp[i]->val = xk[i];
+            }
+            if(++halvings > MAX_HALVINGS) {
+                if(how == SLVS_RESULT_OKAY) how = SLVS_RESULT_DIDNT_CONVERGE;
+                return how;
+            }
+            h = (vnext - vprev)/2;
+        }
+    }
+    return how;
+}
+
+extern "C" {
+
+void Slvs_QuaternionU(double qw, double qx, double qy, double qz,
+                         double *x, double *y, double *z)
+{
+    Quaternion q = Quaternion::From(qw, qx, qy, qz);
+    Vector v = q.RotationU();
+    *x = v.x;
+    *y = v.y;
+    *z = v.z;
+}
+
+void Slvs_QuaternionV(double qw, double qx, double qy, double qz,
+                         double *x, double *y, double *z)
+{
+    Quaternion q = Quaternion::From(qw, qx, qy, qz);
+    Vector v = q.RotationV();
+    *x = v.x;
+    *y = v.y;
+    *z = v.z;
+}
+
+void Slvs_QuaternionN(double qw, double qx, double qy, double qz,
+                         double *x, double *y, double *z)
+{
+    Quaternion q = Quaternion::From(qw, qx, qy, qz);
+    Vector v = q.RotationN();
+    *x = v.x;
+    *y = v.y;
+    *z = v.z;
+}
+
+void Slvs_MakeQuaternion(double ux, double uy, double uz,
+                         double vx, double vy, double vz,
+                         double *qw, double *qx, double *qy, double *qz)
+{
+    Vector u = Vector::From(ux, uy, uz),
+           v = Vector::From(vx, vy, vz);
+    Quaternion q = Quaternion::From(u, v);
+    *qw = q.w;
+    *qx = q.vx;
+    *qy = q.vy;
+    *qz = q.vz;
+}
+
+void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
+{
+    if(!IsInit) {
+        InitHeaps();
+        IsInit = 1;
+    }
+    if(ssys->capture) {
+        Slvs_WriteCapture(ssys, shg, ssys->capture);
+    }
+    StartClock(ssys);
+    StartStats(ssys);
+
+    if(!ImportSketch(ssys)) {
+        ClearSketch();
+        return;
+    }
+
+    ImportGroupParams(ssys, shg);
+    ImportDragged(ssys);
+
     List<hConstraint> bad;
     ZERO(&bad);
 
     // Now we're finally ready to solve!
     bool andFindBad = ssys->calculateFaileds ? true : false;
-    int how = SYS.Solve(&g, &(ssys->dof), &bad, andFindBad, false);
+    ssys->result = SolveGroup(shg, &(ssys->dof), &bad, andFindBad);
 
-    switch(how) {
-        case System::SOLVED_OKAY:
-            ssys->result = SLVS_RESULT_OKAY;
-            break;
+    // Write the new parameter values back to our caller.
+    int i;
+    for(i = 0; i < ssys->params; i++) {
+        Slvs_Param *sp = &(ssys->param[i]);
+        hParam hp = { sp->h };
+        sp->val = SK.GetParam(hp)->val;
+    }
 
-        case System::DIDNT_CONVERGE:
-            ssys->result = SLVS_RESULT_DIDNT_CONVERGE;
-            break;
+    if(ssys->failed) {
+        // Copy over any the list of problematic constraints.
+        for(i = 0; i < ssys->faileds && i < bad.n; i++) {
+            ssys->failed[i] = bad.elem[i].v;
+        }
+        ssys->faileds = bad.n;
+    }
 
-        case System::SINGULAR_JACOBIAN:
-            ssys->result = SLVS_RESULT_INCONSISTENT;
-            break;
+    bad.Clear();
+    FinishStats(ssys);
+    ClearSketch();
+}
 
-        case System::TOO_MANY_UNKNOWNS:
-            ssys->result = SLVS_RESULT_TOO_MANY_UNKNOWNS;
-            break;
+void Slvs_SolveBatch(Slvs_System *ssys, Slvs_hGroup shg,
+                     Slvs_Scenario *scenario, int scenarios)
+{
+    if(!IsInit) {
+        InitHeaps();
+        IsInit = 1;
+    }
+    StartClock(ssys);
+    StartStats(ssys);
 
-        default: oops();
+    if(!ImportSketch(ssys)) {
+        ClearSketch();
+        return;
+    }
+
+    // Give each of the caller's constraints a param that holds its valA, so
+    // that the equations (and the Jacobian, and its compiled code) refer to
+    // that param, and we can write them just once for all the scenarios.
+    // That's not possible if some constraint's equations depend on the
+    // values themselves, or if there's no room for the handles.
+    int i;
+    Slvs_hParam hmax = 0;
+    for(i = 0; i < ssys->params; i++) {
+        hmax = max(hmax, ssys->param[i].h);
+    }
+    bool shared = (hmax <= 0xffffffff - (DWORD)ssys->constraints);
+    for(i = 0; i < ssys->constraints && shared; i++) {
+        hConstraint hc = { ssys->constraint[i].h };
+        ConstraintBase *c = SK.GetConstraint(hc);
+        if(c->group.v == shg && c->EquationsDependOnValues()) shared = false;
+    }
+    if(shared) {
+        for(i = 0; i < ssys->constraints; i++) {
+            hConstraint hc = { ssys->constraint[i].h };
+            ConstraintBase *c = SK.GetConstraint(hc);
+
+            Param p;
+            ZERO(&p);
+            p.h.v = hmax + 1 + i;
+            p.val = c->valA;
+            SK.param.Add(&p);
+            c->valAParam = p.h;
+        }
+    }
+
+    // The sketch doesn't change between scenarios, so look up where each
+    // of the caller's params and constraints landed just once.
+    Param **sp = (Param **)MemAlloc(max(ssys->params, 1)*sizeof(Param *));
+    ConstraintBase **sc = (ConstraintBase **)
+        MemAlloc(max(ssys->constraints, 1)*sizeof(ConstraintBase *));
+    Param **sv = (Param **)MemAlloc(max(ssys->constraints, 1)*sizeof(Param *));
+    for(i = 0; i < ssys->params; i++) {
+        hParam hp = { ssys->param[i].h };
+        sp[i] = SK.GetParam(hp);
+    }
+    for(i = 0; i < ssys->constraints; i++) {
+        hConstraint hc = { ssys->constraint[i].h };
+        sc[i] = SK.GetConstraint(hc);
+        sv[i] = shared ? SK.GetParam(sc[i]->valAParam) : NULL;
+    }
+
+    // Whether the solver still holds the equations from an earlier
+    // scenario, to solve again.
+    bool written = false;
+    int s;
+    for(s = 0; s < scenarios; s++) {
+        Slvs_Scenario *ss = &(scenario[s]);
+
+        for(i = 0; i < ssys->params; i++) {
+            sp[i]->val = ss->param[i];
+            sp[i]->known = false;
+            sp[i]->free = false;
+        }
+        for(i = 0; i < ssys->constraints; i++) {
+            sc[i]->valA = ss->valA ? ss->valA[i] : ssys->constraint[i].valA;
+            if(sv[i]) sv[i]->val = sc[i]->valA;
+        }
+
+        List<hConstraint> bad;
+        ZERO(&bad);
+        if(written) {
+            // The solver's params are where its equations point, so just
+            // start them from this scenario's guess.
+            for(i = 0; i < SYS.param.n; i++) {
+                Param *p = &(SYS.param.elem[i]);
+                p->val = SK.GetParam(p->h)->val;
+            }
+            ss->result = ResultFromSolver(SYS.SolveAgain(&(ss->dof), &bad));
+        } else {
+            ImportGroupParams(ssys, shg);
+            ImportDragged(ssys);
+            ss->result = SolveGroup(shg, &(ss->dof), &bad, false);
+            written = shared && SYS.canSolveAgain;
+        }
+        bad.Clear();
+
+        for(i = 0; i < ssys->params; i++) {
+            ss->param[i] = sp[i]->val;
+        }
+
+        // If we can't solve these equations again, then drop the solver
+        // state and the expressions from this scenario, but keep the
+        // sketch around for the next one.
+        if(!written) ClearSolver();
+    }
+
+    MemFree(sp);
+    MemFree(sc);
+    MemFree(sv);
+    FinishStats(ssys);
+    ClearSketch();
+}
+
+void Slvs_SolveSweep(Slvs_System *ssys, Slvs_hGroup shg,
+                     Slvs_hConstraint shc, double *valA, int steps,
+                     double *param, int *result)
+{
+    if(!IsInit) {
+        InitHeaps();
+        IsInit = 1;
+    }
+    StartClock(ssys);
+    StartStats(ssys);
+
+    if(!ImportSketch(ssys)) {
+        ClearSketch();
+        return;
+    }
+
+    hConstraint hc = { shc };
+    ConstraintBase *c = SK.constraint.FindByIdNoOops(hc);
+    if(!c) {
+        dbp("bad constraint %d", shc);
+        ClearSketch();
+        return;
+    }
+
+    int n = max(ssys->params, 1);
+    Param **sp = (Param **)MemAlloc(n*sizeof(Param *));
+    double *xk = (double *)MemAlloc(n*sizeof(double));
+    double *xp = (double *)MemAlloc(n*sizeof(double));
+    double *x0 = (double *)MemAlloc(n*sizeof(double));
+    int i;
+    for(i = 0; i < ssys->params; i++) {
+        hParam hp = { ssys->param[i].h };
+        sp[i] = SK.GetParam(hp);
+    }
+
+    // Until we've got one solution, there's nothing to continue from.
+    bool onCurve = false;
+    int k;
+    for(k = 0; k < steps; k++) {
+        int how;
+        if(onCurve) {
+            double v0 = c->valA;
+            for(i = 0; i < ssys->params; i++) {
+                x0[i] = sp[i]->val;
+            }
+            how = SweepTo(ssys, shg, c, sp, xk, xp, valA[k], &(ssys->dof));
+            if(how != SLVS_RESULT_OKAY) {
+                // Don't leave the sketch partway to the failed step.
+                c->valA = v0;
+                for(i = 0; i < ssys->params; i++) {
+                    sp[i]->val = x0[i];
+                }
+            }
+        } else {
+            c->valA = valA[k];
+            ImportGroupParams(ssys, shg);
+            ImportDragged(ssys);
+
+            List<hConstraint> bad;
+            ZERO(&bad);
+            how = SolveGroup(shg, &(ssys->dof), &bad, false);
+            bad.Clear();
+            ClearSolver();
+
+            onCurve = (how == SLVS_RESULT_OKAY);
+        }
+        result[k] = how;
+        ssys->result = how;
+
+        // If this step failed, then the params are still at the last good
+        // solution, and that's what the next step will continue from.
+        for(i = 0; i < ssys->params; i++) {
+            param[k*ssys->params + i] = sp[i]->val;
+        }
+    }
+
+    MemFree(sp);
+    MemFree(xk);
+    MemFree(xp);
+    MemFree(x0);
+    FinishStats(ssys);
+    ClearSketch();
+}
+
+void Slvs_SolveAll(Slvs_System *ssys)
+{
+    if(!IsInit) {
+        InitHeaps();
+        IsInit = 1;
+    }
+    StartClock(ssys);
+    StartStats(ssys);
+
+    if(!ImportSketch(ssys)) {
+        ClearSketch();
+        return;
+    }
+
+    Slvs_hGroup *order = (Slvs_hGroup *)MemAlloc(
+        max(ssys->params + ssys->entities + ssys->constraints, 1)*
+            sizeof(Slvs_hGroup));
+    int groups = OrderGroups(ssys, order);
+
+    List<hConstraint> bad;
+    ZERO(&bad);
+    bool andFindBad = ssys->calculateFaileds ? true : false;
+
+    // Each group's solution is written in to the sketch, so the groups
+    // after it see those params as known.
+    ssys->result = SLVS_RESULT_OKAY;
+    ssys->dof = 0;
+    int i;
+    for(i = 0; i < groups; i++) {
+        ImportGroupParams(ssys, order[i]);
+        ImportDragged(ssys);
+
+        int dof = 0;
+        int how = SolveGroup(order[i], &dof, &bad, andFindBad);
+        ClearSolver();
+
+        ssys->dof += dof;
+        if(how != SLVS_RESULT_OKAY) {
+            // The groups after this one might depend on it, so stop here.
+            ssys->result = how;
+            break;
+        }
     }
 
-    // Write the new parameter values back to our caller.
     for(i = 0; i < ssys->params; i++) {
         Slvs_Param *sp = &(ssys->param[i]);
         hParam hp = { sp->h };
@@ -231,7 +823,6 @@ default: dbp("bad constraint type %d", sc->type); return;
     }
 
     if(ssys->failed) {
-        // Copy over any the list of problematic constraints.
         for(i = 0; i < ssys->faileds && i < bad.n; i++) {
             ssys->failed[i] = bad.elem[i].v;
         }
@@ -239,16 +830,85 @@ default: dbp("bad constraint type %d", sc->type); return;
     }
 
     bad.Clear();
-    SYS.param.Clear();
-    SYS.entity.Clear();
-    SYS.eq.Clear();
-    SYS.dragged.Clear();
+    MemFree(order);
+    FinishStats(ssys);
+    ClearSketch();
+}
 
-    SK.param.Clear();
-    SK.entity.Clear();
-    SK.constraint.Clear();
+//-----------------------------------------------------------------------------
+// The caller gives us one vector per point, but the compiled equations want
+// one vector per param (with a lane for each point), so we transpose through
+// our own buffers, EVAL_LANES points at a time.
+//-----------------------------------------------------------------------------
+#define EVAL_LANES (ExprProgram::LANES)
 
-    FreeAllTemporary();
+int Slvs_EvalResiduals(Slvs_System *ssys, Slvs_hGroup shg, int n,
+                       const double *param, double *residual, int residuals)
+{
+    if(!IsInit) {
+        InitHeaps();
+        IsInit = 1;
+    }
+
+    if(!ImportSketch(ssys)) {
+        ClearSketch();
+        return -1;
+    }
+
+    Group g;
+    ZERO(&g);
+    g.h.v = shg;
+    SYS.WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, &g);
+    int m = SYS.eq.n;
+
+    double *pb = (double *)MemAlloc(
+        max(ssys->params, 1)*EVAL_LANES*sizeof(double));
+    double *rb = (double *)MemAlloc(max(m, 1)*EVAL_LANES*sizeof(double));
+    // The index in the caller's param[] of each param in our sketch
+    int *which = (int *)MemAlloc(max(SK.param.n, 1)*sizeof(int));
+    int i, j, k, s;
+    for(i = 0; i < ssys->params; i++) {
+        hParam hp = { ssys->param[i].h };
+        which[SK.GetParam(hp) - SK.param.elem] = i;
+    }
+
+    ExprProgram prog;
+    ZERO(&prog);
+    for(i = 0; i < m; i++) {
+        Expr *e = SYS.eq.elem[i].e->FoldConstants();
+        prog.Add(e, &(rb[i*EVAL_LANES]));
+    }
+    prog.Finish();
+    for(i = 0; i < prog.in.n; i++) {
+        Param *p = SK.GetParam(prog.inParam.elem[i]);
+        prog.in.elem[i].p = &(pb[which[p - SK.param.elem]*EVAL_LANES]);
+    }
+
+    for(s = 0; s < n; s += EVAL_LANES) {
+        int lanes = min(EVAL_LANES, n - s);
+        // Always fill every lane (repeating the last point if we're short),
+        // so that the loops over the lanes are always the same length.
+        for(k = 0; k < EVAL_LANES; k++) {
+            const double *pv = param + (s + min(k, lanes - 1))*ssys->params;
+            for(j = 0; j < ssys->params; j++) {
+                pb[j*EVAL_LANES + k] = pv[j];
+            }
+        }
+        prog.EvalBatch();
+        for(k = 0; k < lanes; k++) {
+            double *rv = residual + (s + k)*residuals;
+            for(i = 0; i < m && i < residuals; i++) {
+                rv[i] = rb[i*EVAL_LANES + k];
+            }
+        }
+    }
+
+    prog.Clear();
+    MemFree(pb);
+    MemFree(rb);
+    MemFree(which);
+    ClearSketch();
+    return m;
 }
 
 }
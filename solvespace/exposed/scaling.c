@@ -0,0 +1,403 @@
+//-----------------------------------------------------------------------------
+// A scaling benchmark for the solver. We generate families of sketches
+// (chains of lines, grids, arrays of four-bar linkages, clouds of points in
+// 3d, and arcs with tangent lines) at a range of sizes, and report how the
+// solve time, Newton iterations, and memory grow with the size. For example,
+//
+//     slvs-scaling -max 3000 grid arcs
+//
+// runs those two families at sizes up to 3000 entities. By default, the
+// sizes go up to 1000 entities; they go up to 100000 with -max 100000.
+//
+// Copyright 2008-2013 Jonathan Westhues.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "slvs.h"
+
+Slvs_System sys;
+
+// The workplane and 2d normal are in group 1; the sketch is group 2.
+#define BASE    1
+#define SKETCH  2
+Slvs_hEntity Wrkpl, Normal;
+
+void *CheckMalloc(size_t n)
+{
+    void *r = malloc(n);
+    if(!r) {
+        printf("out of memory!\n");
+        exit(-1);
+    }
+    return r;
+}
+
+double Milliseconds(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec*1000.0 + tv.tv_usec/1000.0;
+}
+
+// A little pseudo-random jitter, so that the solver has some work to do;
+// always the same sequence, so that runs are comparable.
+unsigned int Seed;
+double Jitter(double mag)
+{
+    Seed = Seed*1103515245 + 12345;
+    return mag*((((Seed >> 8) & 0xffff)/65536.0) - 0.5);
+}
+
+//-----------------------------------------------------------------------------
+// Helpers to build the sketch; the handles are just assigned in order.
+//-----------------------------------------------------------------------------
+Slvs_hParam Param(Slvs_hGroup g, double v)
+{
+    sys.param[sys.params] = Slvs_MakeParam(sys.params + 1, g, v);
+    return ++sys.params;
+}
+
+Slvs_hEntity AddEntity(Slvs_Entity e)
+{
+    e.h = sys.entities + 1;
+    sys.entity[sys.entities++] = e;
+    return e.h;
+}
+
+Slvs_hEntity Point2d(double u, double v)
+{
+    Slvs_hParam pu = Param(SKETCH, u + Jitter(1)),
+                pv = Param(SKETCH, v + Jitter(1));
+    return AddEntity(Slvs_MakePoint2d(0, SKETCH, Wrkpl, pu, pv));
+}
+
+Slvs_hEntity Point3d(double x, double y, double z)
+{
+    Slvs_hParam px = Param(SKETCH, x + Jitter(1)),
+                py = Param(SKETCH, y + Jitter(1)),
+                pz = Param(SKETCH, z + Jitter(1));
+    return AddEntity(Slvs_MakePoint3d(0, SKETCH, px, py, pz));
+}
+
+Slvs_hEntity Line(Slvs_hEntity a, Slvs_hEntity b)
+{
+    return AddEntity(Slvs_MakeLineSegment(0, SKETCH, Wrkpl, a, b));
+}
+
+void Constrain(int type, Slvs_hEntity wrkpl, double valA,
+               Slvs_hEntity ptA, Slvs_hEntity ptB,
+               Slvs_hEntity entityA, Slvs_hEntity entityB)
+{
+    sys.constraint[sys.constraints] = Slvs_MakeConstraint(
+        sys.constraints + 1, SKETCH, type, wrkpl, valA,
+        ptA, ptB, entityA, entityB);
+    sys.constraints++;
+}
+
+void Begin(int space)
+{
+    sys.params = sys.entities = sys.constraints = 0;
+    sys.param      = (Slvs_Param *)CheckMalloc(space*sizeof(Slvs_Param));
+    sys.entity     = (Slvs_Entity *)CheckMalloc(space*sizeof(Slvs_Entity));
+    sys.constraint = (Slvs_Constraint *)
+                                CheckMalloc(space*sizeof(Slvs_Constraint));
+    sys.failed  = NULL;
+    sys.faileds = 0;
+    Seed = 1;
+
+    // The workplane is the xy plane, fixed since it's not in our group.
+    double qw, qx, qy, qz;
+    Slvs_MakeQuaternion(1, 0, 0, 0, 1, 0, &qw, &qx, &qy, &qz);
+    Slvs_hParam ox = Param(BASE, 0), oy = Param(BASE, 0), oz = Param(BASE, 0);
+    Slvs_hEntity origin = AddEntity(Slvs_MakePoint3d(0, BASE, ox, oy, oz));
+    Slvs_hParam nw = Param(BASE, qw), nx = Param(BASE, qx),
+                ny = Param(BASE, qy), nz = Param(BASE, qz);
+    Slvs_hEntity n = AddEntity(Slvs_MakeNormal3d(0, BASE, nw, nx, ny, nz));
+    Wrkpl  = AddEntity(Slvs_MakeWorkplane(0, BASE, origin, n));
+    Normal = AddEntity(Slvs_MakeNormal2d(0, BASE, Wrkpl));
+}
+
+void End(void)
+{
+    free(sys.param);
+    free(sys.entity);
+    free(sys.constraint);
+}
+
+//-----------------------------------------------------------------------------
+// The families of sketches. Each builds a sketch with about n entities.
+//-----------------------------------------------------------------------------
+
+// A zigzag polyline, with the length of each segment dimensioned, and its
+// first point dragged.
+void Chain(int n)
+{
+    Slvs_hEntity prev = Point2d(0, 0);
+    Constrain(SLVS_C_WHERE_DRAGGED, Wrkpl, 0, prev, 0, 0, 0);
+    int i;
+    for(i = 1; 2*i < n; i++) {
+        Slvs_hEntity pt = Point2d(i*10.0, (i % 2)*10.0);
+        Line(prev, pt);
+        Constrain(SLVS_C_PT_PT_DISTANCE, Wrkpl, 14, prev, pt, 0, 0);
+        prev = pt;
+    }
+}
+
+// A square grid of lines, with every horizontal line horizontal, every
+// vertical line but the last column vertical and the last column parallel
+// to the first, and the cells along the bottom and left equal.
+void Grid(int n)
+{
+    int s = (int)sqrt(n/3.0), i, j;
+    if(s < 1) s = 1;
+
+    Slvs_hEntity *pt = (Slvs_hEntity *)
+                            CheckMalloc((s+1)*(s+1)*sizeof(Slvs_hEntity));
+    Slvs_hEntity *h  = (Slvs_hEntity *)
+                            CheckMalloc((s+1)*s*sizeof(Slvs_hEntity));
+    Slvs_hEntity *v  = (Slvs_hEntity *)
+                            CheckMalloc(s*(s+1)*sizeof(Slvs_hEntity));
+#define PT(i, j) pt[(i)*(s+1) + (j)]
+#define H(i, j)  h[(i)*s + (j)]
+#define V(i, j)  v[(i)*(s+1) + (j)]
+    for(i = 0; i <= s; i++) {
+        for(j = 0; j <= s; j++) {
+            PT(i, j) = Point2d(j*10.0, i*10.0);
+        }
+    }
+    for(i = 0; i <= s; i++) {
+        for(j = 0; j < s; j++) {
+            H(i, j) = Line(PT(i, j), PT(i, j+1));
+            Constrain(SLVS_C_HORIZONTAL, Wrkpl, 0, 0, 0, H(i, j), 0);
+        }
+    }
+    for(i = 0; i < s; i++) {
+        for(j = 0; j <= s; j++) {
+            V(i, j) = Line(PT(i, j), PT(i+1, j));
+            if(j < s) {
+                Constrain(SLVS_C_VERTICAL, Wrkpl, 0, 0, 0, V(i, j), 0);
+            } else {
+                Constrain(SLVS_C_PARALLEL, Wrkpl, 0, 0, 0, V(i, j), V(i, 0));
+            }
+        }
+    }
+    for(j = 1; j < s; j++) {
+        Constrain(SLVS_C_EQUAL_LENGTH_LINES, Wrkpl, 0, 0, 0, H(0, j-1), H(0, j));
+    }
+    for(i = 1; i < s; i++) {
+        Constrain(SLVS_C_EQUAL_LENGTH_LINES, Wrkpl, 0, 0, 0, V(i-1, 0), V(i, 0));
+    }
+    Constrain(SLVS_C_WHERE_DRAGGED, Wrkpl, 0, PT(0, 0), 0, 0, 0);
+#undef PT
+#undef H
+#undef V
+    free(pt);
+    free(h);
+    free(v);
+}
+
+// A row of four-bar linkages, each with its two ground pivots dragged, so
+// one degree of freedom each.
+void FourBar(int n)
+{
+    int i;
+    for(i = 0; 7*i < n || i == 0; i++) {
+        double x = i*60.0;
+        Slvs_hEntity a = Point2d(x,      0),
+                     b = Point2d(x + 40, 0),
+                     c = Point2d(x + 10, 20),
+                     d = Point2d(x + 35, 25);
+        Line(a, c);
+        Line(c, d);
+        Line(d, b);
+        Constrain(SLVS_C_WHERE_DRAGGED, Wrkpl, 0, a, 0, 0, 0);
+        Constrain(SLVS_C_WHERE_DRAGGED, Wrkpl, 0, b, 0, 0, 0);
+        Constrain(SLVS_C_PT_PT_DISTANCE, Wrkpl, sqrt(10.0*10 + 20*20),
+                  a, c, 0, 0);
+        Constrain(SLVS_C_PT_PT_DISTANCE, Wrkpl, sqrt(25.0*25 + 5*5),
+                  c, d, 0, 0);
+        Constrain(SLVS_C_PT_PT_DISTANCE, Wrkpl, sqrt(5.0*5 + 25*25),
+                  d, b, 0, 0);
+    }
+}
+
+// Points in 3d, each dimensioned to the three before it, with the first
+// three dragged; so the whole thing is rigid.
+void Cloud(int n)
+{
+    int m = (n > 3) ? n : 3, i, j;
+    Slvs_hEntity *pt = (Slvs_hEntity *)CheckMalloc(m*sizeof(Slvs_hEntity));
+    double *xyz = (double *)CheckMalloc(3*m*sizeof(double));
+    for(i = 0; i < m; i++) {
+        double *p = &(xyz[3*i]);
+        p[0] = 50 + Jitter(100);
+        p[1] = 50 + Jitter(100);
+        p[2] = 50 + Jitter(100);
+        pt[i] = Point3d(p[0], p[1], p[2]);
+        if(i < 3) {
+            Constrain(SLVS_C_WHERE_DRAGGED, SLVS_FREE_IN_3D, 0,
+                      pt[i], 0, 0, 0);
+            continue;
+        }
+        for(j = i - 3; j < i; j++) {
+            double *q = &(xyz[3*j]);
+            double d = sqrt((p[0]-q[0])*(p[0]-q[0]) + (p[1]-q[1])*(p[1]-q[1]) +
+                            (p[2]-q[2])*(p[2]-q[2]));
+            Constrain(SLVS_C_PT_PT_DISTANCE, SLVS_FREE_IN_3D, d,
+                      pt[i], pt[j], 0, 0);
+        }
+    }
+    free(pt);
+    free(xyz);
+}
+
+// A row of quarter arcs, each with a line tangent at either end; the lines
+// are joined to the arcs by point-coincident constraints.
+void Arcs(int n)
+{
+    int i;
+    for(i = 0; 10*i < n || i == 0; i++) {
+        double x = i*50.0;
+        Slvs_hEntity p0 = Point2d(x - 20, 10),
+                     p1 = Point2d(x,      10),
+                     c  = Point2d(x,      20),
+                     s  = Point2d(x,      10),
+                     e  = Point2d(x + 10, 20),
+                     q0 = Point2d(x + 10, 20),
+                     q1 = Point2d(x + 10, 40);
+        Slvs_hEntity l1 = Line(p0, p1),
+                     l2 = Line(q0, q1),
+                     arc = AddEntity(Slvs_MakeArcOfCircle(0, SKETCH, Wrkpl,
+                                        Normal, c, s, e));
+        Constrain(SLVS_C_POINTS_COINCIDENT, Wrkpl, 0, p1, s, 0, 0);
+        Constrain(SLVS_C_POINTS_COINCIDENT, Wrkpl, 0, e, q0, 0, 0);
+        sys.constraint[sys.constraints] = Slvs_MakeConstraint(
+            sys.constraints + 1, SKETCH, SLVS_C_ARC_LINE_TANGENT, Wrkpl, 0,
+            0, 0, arc, l1);
+        sys.constraints++;
+        sys.constraint[sys.constraints] = Slvs_MakeConstraint(
+            sys.constraints + 1, SKETCH, SLVS_C_ARC_LINE_TANGENT, Wrkpl, 0,
+            0, 0, arc, l2);
+        sys.constraint[sys.constraints].other = 1;
+        sys.constraints++;
+    }
+}
+
+typedef struct {
+    const char  *name;
+    void       (*build)(int n);
+    // Generous upper bounds on params, entities, and constraints per entity
+    int          space;
+} Family;
+
+Family Families[] = {
+    { "chain",      Chain,      4 },
+    { "grid",       Grid,       4 },
+    { "fourbar",    FourBar,    4 },
+    { "cloud",      Cloud,      4 },
+    { "arcs",       Arcs,       4 },
+};
+
+int Sizes[] = { 10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000 };
+
+const char *ResultName(int result)
+{
+    switch(result) {
+        case SLVS_RESULT_OKAY:              return "okay";
+        case SLVS_RESULT_INCONSISTENT:      return "inconsistent";
+        case SLVS_RESULT_DIDNT_CONVERGE:    return "didnt-converge";
+        case SLVS_RESULT_TOO_MANY_UNKNOWNS: return "too-many";
+        case SLVS_RESULT_TIMED_OUT:         return "timed-out";
+        default:                            return "?";
+    }
+}
+
+void Run(Family *f, int n, int runs)
+{
+    Begin(f->space*n + 100);
+    f->build(n);
+
+    double *initial = (double *)CheckMalloc((sys.params + 1)*sizeof(double));
+    double *t = (double *)CheckMalloc(runs*sizeof(double));
+    int i, r;
+    for(i = 0; i < sys.params; i++) {
+        initial[i] = sys.param[i].val;
+    }
+
+    Slvs_Stats stats;
+    for(r = 0; r < runs; r++) {
+        for(i = 0; i < sys.params; i++) {
+            sys.param[i].val = initial[i];
+        }
+        memset(&stats, 0, sizeof(stats));
+        sys.stats = &stats;
+
+        double t0 = Milliseconds();
+        Slvs_Solve(&sys, SKETCH);
+        t[r] = Milliseconds() - t0;
+    }
+    sys.stats = NULL;
+
+    // Report the median time, and the stats from the last run.
+    int j;
+    for(i = 1; i < runs; i++) {
+        double v = t[i];
+        for(j = i; j > 0 && t[j-1] > v; j--) t[j] = t[j-1];
+        t[j] = v;
+    }
+    printf("%-8s %8d %8d %8d %-14s %6d %10.3f %6d %8d %10.0f\n",
+        f->name, sys.entities, sys.params, sys.constraints,
+        ResultName(sys.result), sys.dof, t[runs/2], stats.iterations,
+        stats.exprNodes, stats.temporaryBytes/1024);
+    fflush(stdout);
+
+    free(initial);
+    free(t);
+    End();
+}
+
+int main(int argc, char **argv)
+{
+    int maxSize = 1000, runs = 3;
+    int i = 1;
+    while(i + 1 < argc && argv[i][0] == '-') {
+        if(strcmp(argv[i], "-max") == 0) {
+            maxSize = atoi(argv[i + 1]);
+        } else if(strcmp(argv[i], "-runs") == 0) {
+            runs = atoi(argv[i + 1]);
+        } else {
+            break;
+        }
+        i += 2;
+    }
+    if(runs < 1 || (i < argc && argv[i][0] == '-')) {
+        printf("usage: slvs-scaling [-max entities] [-runs runs] "
+               "[family...]\n");
+        return 1;
+    }
+
+    printf("%-8s %8s %8s %8s %-14s %6s %10s %6s %8s %10s\n",
+        "family", "entities", "params", "constrs", "result", "dof",
+        "median ms", "iters", "nodes", "temp KB");
+
+    int f, s;
+    for(f = 0; f < (int)(sizeof(Families)/sizeof(Families[0])); f++) {
+        if(i < argc) {
+            // Only the families named on the command line
+            int k;
+            for(k = i; k < argc; k++) {
+                if(strcmp(argv[k], Families[f].name) == 0) break;
+            }
+            if(k >= argc) continue;
+        }
+        for(s = 0; s < (int)(sizeof(Sizes)/sizeof(Sizes[0])); s++) {
+            if(Sizes[s] > maxSize) break;
+            Run(&Families[f], Sizes[s], runs);
+        }
+    }
+    return 0;
+}
@@ -135,6 +135,44 @@ typedef struct {
     int                 other2;
 } Slvs_Constraint;
 
+// Where the solver spends its time, for profiling. All the times are in
+// milliseconds, and all the counts are summed over every solve in the call
+// (so for Slvs_SolveBatch, over all the scenarios).
+typedef struct {
+    // Time in each phase of the solve: generating the equations, solving
+    // the trivial ones by substitution, writing and evaluating the
+    // Jacobian, the rank test, Newton's method, and finding the failed
+    // (or free) constraints. The total also includes the time to copy
+    // in the sketch, which isn't any of those phases.
+    double              generateTime;
+    double              substituteTime;
+    double              jacobianTime;
+    double              rankTime;
+    double              newtonTime;
+    double              diagnoseTime;
+    double              totalTime;
+
+    // The number of equations and params before and after substitution,
+    // and the number of nodes in the expressions for what's left (the
+    // equations and all their partial derivatives).
+    int                 equations;
+    int                 params;
+    int                 equationsLeft;
+    int                 paramsLeft;
+    int                 exprNodes;
+
+    // The system is split in to blocks, each solved by Newton's method.
+    // The caller may allocate the array blockIteration[], and pass its size
+    // in blocks; the solver writes the number of iterations for each
+    // block there, and sets blocks to the number of blocks. iterations is
+    // the total over all the blocks.
+    int                 *blockIteration;
+    int                 blocks;
+    int                 iterations;
+
+    // The memory allocated for expressions and other temporary stuff
+    double              temporaryBytes;
+} Slvs_Stats;
 
 typedef struct {
     //// INPUT VARIABLES
@@ -191,12 +229,133 @@ typedef struct {
 #define SLVS_RESULT_INCONSISTENT        1
 #define SLVS_RESULT_DIDNT_CONVERGE      2
 #define SLVS_RESULT_TOO_MANY_UNKNOWNS   3
+#define SLVS_RESULT_TIMED_OUT           4
     int                 result;
+
+    //// OPTIONAL INPUT VARIABLES
+    //
+    // These were added after the fields above, and so come after them,
+    // to keep the layout of the fields above unchanged. Set any that
+    // aren't used to zero; the solver dereferences cancel and stats, and
+    // opens capture as a filename, if they're not NULL.
+    //
+    // To bound the time spent in the solver, set timeout to a number of
+    // milliseconds; zero means no limit. The solver can also be stopped
+    // early from some other thread, by pointing cancel at an int that
+    // the other thread sets nonzero. Either way, the solver gives up
+    // at its next check (between Newton iterations, and between the
+    // rank tests when finding the failed constraints), and reports
+    // SLVS_RESULT_TIMED_OUT, with the best params that it had found.
+    // For a batch or a sweep, the timeout covers the whole call.
+    int                 timeout;
+    volatile int        *cancel;
+
+    // To see where the time goes, point stats at an Slvs_Stats; the solver
+    // fills it in. If stats is NULL, then the solver doesn't bother.
+    Slvs_Stats          *stats;
+
+    // To save a copy of the problem for later (for example, to reproduce
+    // a slow solve), set capture to a filename; Slvs_Solve will write the
+    // system to that file, in the format read by Slvs_ReadCapture, before
+    // solving it.
+    char                *capture;
 } Slvs_System;
 
 DLL void Slvs_Solve(Slvs_System *sys, Slvs_hGroup hg);
 
 
+// To solve the same sketch many times, with different dimensions or initial
+// guesses (for example, to sweep through a design space), describe each
+// solve as a scenario and pass them all to Slvs_SolveBatch. The sketch is
+// imported just once, and the equations and their Jacobian are written
+// just once and then evaluated for each scenario, which saves most of the
+// cost of calling Slvs_Solve repeatedly. (If the group has a constraint
+// whose equations depend on the current values, like WHERE_DRAGGED, then
+// those are written again for each scenario; see DOC.txt.)
+typedef struct {
+    //// INPUT VARIABLES
+    //
+    // The dimension for each constraint, in the same order as the
+    // constraint[] array of the Slvs_System, replacing its valA. If this
+    // is NULL, then the valA of the Slvs_System is used.
+    double              *valA;
+
+    //// IN/OUT VARIABLES
+    //
+    // The initial guess for each parameter, in the same order as the
+    // param[] array of the Slvs_System. This must not be NULL. The
+    // solver writes its result here, and leaves the Slvs_System itself
+    // untouched.
+    double              *param;
+
+    //// OUTPUT VARIABLES
+    //
+    // As for the Slvs_System. The failed constraints are not reported
+    // for a batch solve.
+    int                 dof;
+    int                 result;
+} Slvs_Scenario;
+
+DLL void Slvs_SolveBatch(Slvs_System *sys, Slvs_hGroup hg,
+                         Slvs_Scenario *scenario, int scenarios);
+
+
+// To sweep one dimension through a range of values (for example, to animate
+// a mechanism), use Slvs_SolveSweep. The constraint hc gets each value in
+// valA[0] ... valA[steps-1] in turn. Each solution is found by continuing
+// from the previous one: the solver predicts where the params will move
+// from the tangent to the solution curve, and then corrects that, taking
+// smaller steps where needed to stay on the same branch of the solution.
+//
+// The solution for step i is written to param[i*params] through
+// param[i*params + params-1], in the same order as the param[] array of
+// the system, and its SLVS_RESULT_* to result[i]. If a step fails, then
+// its params are those of the last step that succeeded, and the next step
+// continues from there. The Slvs_System's own param[] is not modified,
+// but its dof and result are set as for the last step.
+DLL void Slvs_SolveSweep(Slvs_System *sys, Slvs_hGroup hg,
+                         Slvs_hConstraint hc, double *valA, int steps,
+                         double *param, int *result);
+
+
+// To solve every group in the system, use Slvs_SolveAll instead of calling
+// Slvs_Solve once per group. The groups are solved in order, each after
+// any group whose params or entities it refers to (and otherwise in order
+// of their handles), and each group's solution is known when solving the
+// groups that come after it. The sketch is imported only once.
+//
+// If a group fails, then the groups after it aren't solved; result and
+// failed[] are set from the group that failed. dof is the total over the
+// groups that were solved.
+DLL void Slvs_SolveAll(Slvs_System *sys);
+
+// To evaluate the equations of group hg at many points at once (for
+// example, to sample a design space, or to pick good starting points for
+// several solves), use Slvs_EvalResiduals; nothing is solved, and the
+// system isn't modified. param holds n vectors of params, each in the same
+// order as the param[] array of the system, so that vector i is param[i*
+// params] through param[i*params + params-1]. The residuals at vector i
+// are written to residual[i*residuals] through residual[i*residuals +
+// residuals-1]; each is zero where its equation is satisfied.
+//
+// Returns the number of equations (and if that's more than residuals,
+// then only the first residuals of them are written), or -1 if the system
+// has an entity or constraint of unknown type.
+DLL int Slvs_EvalResiduals(Slvs_System *sys, Slvs_hGroup hg, int n,
+                           const double *param, double *residual,
+                           int residuals);
+
+// Save the system (and the group to solve) to a file, and read it back.
+// Slvs_ReadCapture fills in a zeroed Slvs_System, allocating its param[],
+// entity[], constraint[], and failed[] arrays; free those with
+// Slvs_FreeCapture. Both return nonzero on success.
+DLL int Slvs_WriteCapture(Slvs_System *sys, Slvs_hGroup hg,
+                          const char *filename);
+DLL int Slvs_ReadCapture(const char *filename, Slvs_System *sys,
+                         Slvs_hGroup *hg);
+DLL void Slvs_FreeCapture(Slvs_System *sys);
+
+
 // Our base coordinate system has basis vectors
 //     (1, 0, 0)  (0, 1, 0)  (0, 0, 1)
 // A unit quaternion defines a rotation to a new coordinate system with
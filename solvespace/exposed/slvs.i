@@ -52,6 +52,17 @@
 
 %ignore param;
 
+// These take or fill arrays of doubles, which the double * typemaps above
+// would turn in to a single double on the stack; use System.sweep()
+// instead. The capture functions allocate and free the arrays of the
+// Slvs_System, which the System class owns.
+%ignore Slvs_Scenario;
+%ignore Slvs_SolveBatch;
+%ignore Slvs_SolveSweep;
+%ignore Slvs_EvalResiduals;
+%ignore Slvs_ReadCapture;
+%ignore Slvs_FreeCapture;
+
 
 %include "slvs.h"
 
@@ -642,6 +653,29 @@ public:
 
     int solve(Slvs_hGroup hg = 0);
 
+    void sweep_clear();
+    void sweep_add_value(double v)
+        throw(out_of_memory_exception);
+    int sweep_run(Constraint c, Slvs_hGroup hg = 0)
+        throw(out_of_memory_exception, wrong_system_exception);
+    int sweep_result(int k)
+        throw(invalid_value_exception);
+    double sweep_param(int k, int i)
+        throw(invalid_value_exception);
+
+    %pythoncode %{
+        # Sweep the dimension of a constraint through some values, as for
+        # Slvs_SolveSweep. Returns one (result, params) for each value,
+        # with the params in the same order as get_param().
+        def sweep(self, constraint, values, group = 0):
+            self.sweep_clear()
+            for v in values:
+                self.sweep_add_value(v)
+            steps = self.sweep_run(constraint, group)
+            return [ (self.sweep_result(k),
+                      [ self.sweep_param(k, i) for i in range(self.params) ])
+                     for k in range(steps) ]
+    %}
 
     // entities
 
@@ -604,6 +604,13 @@ public:
 class System : public Slvs_System {
     int param_space, entity_space, constraint_space, failed_space;
 
+    // The values for the next sweep, and the results of the last one; we
+    // own these, so that the caller never has to pass us an array.
+    double *sweep_values;
+    double *sweep_params;
+    int    *sweep_results;
+    int     sweep_steps, sweep_space, sweep_solved;
+
     void init(int param_space, int entity_space, int constraint_space,
                 int failed_space) {
         memset((Slvs_System *)this, 0, sizeof(Slvs_System));
@@ -623,6 +630,13 @@ class System : public Slvs_System {
             throw out_of_memory_exception("out of memory!");
         }
 
+        sweep_values  = NULL;
+        sweep_params  = NULL;
+        sweep_results = NULL;
+        sweep_steps   = 0;
+        sweep_space   = 0;
+        sweep_solved  = 0;
+
         default_group = 1;
     }
 public:
@@ -644,6 +658,9 @@ public:
         free(entity);
         free(constraint);
         free(failed);
+        free(sweep_values);
+        free(sweep_params);
+        free(sweep_results);
     }
 
     Slvs_hGroup default_group;
@@ -840,6 +857,73 @@ public:
         return result;
     }
 
+    // Sweep the dimension of a constraint through some values, as for
+    // Slvs_SolveSweep. Add the values with sweep_add_value(), then
+    // sweep_run() solves for each of them in turn; the solutions are kept
+    // until the next sweep_clear(), and read back with sweep_result() and
+    // sweep_param(). From Python, sweep() does all of that.
+    void sweep_clear() {
+        sweep_steps  = 0;
+        sweep_solved = 0;
+    }
+
+    void sweep_add_value(double v) {
+        if (sweep_steps >= sweep_space) {
+            int n = sweep_space ? sweep_space*2 : 16;
+            double *values = (double *) realloc(sweep_values,
+                                                n * sizeof(double));
+            if (!values)
+                throw out_of_memory_exception("out of memory!");
+            sweep_values = values;
+            sweep_space = n;
+        }
+        sweep_values[sweep_steps++] = v;
+    }
+
+    int sweep_run(Constraint c, Slvs_hGroup hg = 0) {
+        if (c.system() != this)
+            throw wrong_system_exception(
+                "This constraint belongs to another system!");
+        if (hg == 0)
+            hg = default_group;
+
+        int steps = sweep_steps ? sweep_steps : 1;
+        free(sweep_params);
+        free(sweep_results);
+        sweep_params  = (double *) malloc(steps * (params ? params : 1) *
+                                          sizeof(double));
+        sweep_results = (int *)    malloc(steps * sizeof(int));
+        if (!sweep_params || !sweep_results)
+            throw out_of_memory_exception("out of memory!");
+
+        // In case the library can't even start, every step reports that
+        // it failed, with the params where they were.
+        for (int k=0;k<sweep_steps;k++) {
+            sweep_results[k] = SLVS_RESULT_DIDNT_CONVERGE;
+            for (int i=0;i<params;i++)
+                sweep_params[k*params + i] = param[i].val;
+        }
+
+        Slvs_SolveSweep((Slvs_System *)this, hg, c.handle(),
+            sweep_values, sweep_steps, sweep_params, sweep_results);
+        sweep_solved = sweep_steps;
+        return sweep_solved;
+    }
+
+    int sweep_result(int k) {
+        if (k < 0 || k >= sweep_solved)
+            throw invalid_value_exception("invalid sweep step: %d", k);
+        return sweep_results[k];
+    }
+
+    double sweep_param(int k, int i) {
+        if (k < 0 || k >= sweep_solved)
+            throw invalid_value_exception("invalid sweep step: %d", k);
+        if (i < 0 || i >= params)
+            throw invalid_value_exception("invalid param index: %d", i);
+        return sweep_params[k*params + i];
+    }
+
 
     // entities
 
@@ -126,6 +126,32 @@ class TestSlvs(unittest.TestCase):
         else:
             self.assertTrue(False, "solve failed")
 
+    #-----------------------------------------------------------------------------
+    # Sweep the distance between two points, and check that each step of the
+    # sweep is solved to its own distance.
+    #-----------------------------------------------------------------------------
+    def test_sweep(self):
+        sys = System()
+
+        p1 = Point3d(Param(0.0), Param(0.0), Param(0.0), sys)
+        p2 = Point3d(Param(10.0), Param(1.0), Param(0.0), sys)
+        c = Constraint.distance(10.0, p1, p2)
+        sys.set_dragged(p1)
+
+        values = [ 10.0, 12.0, 15.0, 20.0 ]
+        steps = sys.sweep(c, values)
+
+        self.assertEqual(len(steps), len(values))
+        for (result, params), v in zip(steps, values):
+            self.assertEqual(result, SLVS_RESULT_OKAY)
+            d = Vector(params[3:6]) - Vector(params[0:3])
+            self.assertFloatEqual(d.length(), v)
+            # the dragged point stays put
+            self.assertFloatListEqual(params[0:3], [ 0.0, 0.0, 0.0 ])
+
+        # The system's own params aren't changed by a sweep.
+        self.assertFloatEqual(sys.get_param(3).val, 10.0)
+
     #-----------------------------------------------------------------------------
     # An example of a constraint in 2d. In our first group, we create a workplane
     # along the reference frame's xy plane. In a second group, we create some
@@ -299,6 +299,7 @@ Expr *Expr::DeepCopyWithParamsAsPointers(IdList<Param,hParam> *firstTry,
     }
 
     *n = *this;
+    n->marker = 0;
     int c = n->Children();
     if(c > 0) n->a = a->DeepCopyWithParamsAsPointers(firstTry, thenTry);
     if(c > 1) n->b = b->DeepCopyWithParamsAsPointers(firstTry, thenTry);
@@ -372,6 +373,253 @@ Expr *Expr::PartialWrt(hParam p) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Evaluate the expression, and also its partial derivatives with respect to
+// each of the n params in wrt[] (written to d[]), in one walk of the tree.
+// That's forward-mode automatic differentiation, so we don't have to build
+// any trees for the partials.
+//-----------------------------------------------------------------------------
+double Expr::EvalDual(hParam *wrt, int n, double *d) {
+    double va, vb, r, da[MAX_DUAL], db[MAX_DUAL];
+    hParam h;
+    int i;
+
+    switch(op) {
+        case PARAM:     h = x.parh;       va = SK.GetParam(h)->val; goto param;
+        case PARAM_PTR: h = x.parp->h;    va = x.parp->val;         goto param;
+param:
+            for(i = 0; i < n; i++) {
+                d[i] = (wrt[i].v == h.v) ? 1 : 0;
+            }
+            return va;
+
+        case CONSTANT:
+            for(i = 0; i < n; i++) d[i] = 0;
+            return x.v;
+    }
+
+    va = a->EvalDual(wrt, n, da);
+    if(Children() >= 2) {
+        vb = b->EvalDual(wrt, n, db);
+    } else {
+        // The unary ops never read these, but don't leave them unset.
+        vb = 0;
+        for(i = 0; i < n; i++) db[i] = 0;
+    }
+
+    // Where a partial of the operands is zero, so is the partial of the
+    // result; we don't want something like 0/0 to make that a NaN.
+    switch(op) {
+        case PLUS:
+            for(i = 0; i < n; i++) d[i] = da[i] + db[i];
+            return va + vb;
+
+        case MINUS:
+            for(i = 0; i < n; i++) d[i] = da[i] - db[i];
+            return va - vb;
+
+        case TIMES:
+            for(i = 0; i < n; i++) d[i] = da[i]*vb + va*db[i];
+            return va*vb;
+
+        case DIV:
+            r = va/vb;
+            for(i = 0; i < n; i++) {
+                d[i] = (da[i] == 0 && db[i] == 0) ? 0 : (da[i] - r*db[i])/vb;
+            }
+            return r;
+
+        case NEGATE:
+            for(i = 0; i < n; i++) d[i] = -da[i];
+            return -va;
+
+        case SQRT:
+            r = sqrt(va);
+            for(i = 0; i < n; i++) d[i] = (da[i] == 0) ? 0 : da[i]*0.5/r;
+            return r;
+
+        case SQUARE:
+            for(i = 0; i < n; i++) d[i] = 2*va*da[i];
+            return va*va;
+
+        case SIN:
+            r = cos(va);
+            for(i = 0; i < n; i++) d[i] = r*da[i];
+            return sin(va);
+
+        case COS:
+            r = -sin(va);
+            for(i = 0; i < n; i++) d[i] = r*da[i];
+            return cos(va);
+
+        case ASIN:
+        case ACOS:
+            r = sqrt(1 - va*va);
+            if(op == ACOS) r = -r;
+            for(i = 0; i < n; i++) d[i] = (da[i] == 0) ? 0 : da[i]/r;
+            return (op == ASIN) ? asin(va) : acos(va);
+
+        default: oops();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Bounds on the value of the expression, by interval arithmetic, for any
+// values of the params in unknown, with every other param at its current
+// value. The bounds may be loose, but aside from rounding they're never too
+// tight; an infinite bound means that we don't know.
+//-----------------------------------------------------------------------------
+static double IntervalTimes(double a, double b) {
+    // Here zero times infinity is zero, since the infinities are bounds
+    // and not values.
+    if(a == 0 || b == 0) return 0;
+    return a*b;
+}
+
+static void IntervalSin(double lo, double hi, double *rlo, double *rhi) {
+    if(!(hi - lo < 2*PI)) {
+        *rlo = -1;
+        *rhi = 1;
+        return;
+    }
+    double a = sin(lo), b = sin(hi);
+    *rlo = min(a, b);
+    *rhi = max(a, b);
+    // And the extremes, if there's a peak or a trough in the interval
+    if(PI/2 + 2*PI*ceil((lo - PI/2)/(2*PI)) <= hi) *rhi = 1;
+    if(-PI/2 + 2*PI*ceil((lo + PI/2)/(2*PI)) <= hi) *rlo = -1;
+}
+
+void Expr::EvalInterval(ParamList *unknown, double *lo, double *hi) {
+    double alo, ahi, blo, bhi, p[4];
+    hParam h;
+    int i;
+
+    switch(op) {
+        case PARAM:
+            h = x.parh;
+            if(!unknown->FindByIdNoOops(h)) {
+                *lo = *hi = SK.GetParam(h)->val;
+                return;
+            }
+            *lo = -HUGE_VAL;
+            *hi = HUGE_VAL;
+            return;
+
+        case PARAM_PTR:
+            h = x.parp->h;
+            if(!unknown->FindByIdNoOops(h)) {
+                *lo = *hi = x.parp->val;
+                return;
+            }
+            *lo = -HUGE_VAL;
+            *hi = HUGE_VAL;
+            return;
+
+        case CONSTANT:
+            *lo = *hi = x.v;
+            return;
+    }
+
+    a->EvalInterval(unknown, &alo, &ahi);
+    if(Children() >= 2) b->EvalInterval(unknown, &blo, &bhi);
+
+    switch(op) {
+        case PLUS:
+            *lo = alo + blo;
+            *hi = ahi + bhi;
+            break;
+
+        case MINUS:
+            *lo = alo - bhi;
+            *hi = ahi - blo;
+            break;
+
+        case DIV:
+            if(blo <= 0 && bhi >= 0) {
+                *lo = -HUGE_VAL;
+                *hi = HUGE_VAL;
+                break;
+            }
+            // Dividing by b is multiplying by [1/bhi, 1/blo].
+            p[0] = 1/bhi;
+            bhi = 1/blo;
+            blo = p[0];
+            // fall through
+        case TIMES:
+            p[0] = IntervalTimes(alo, blo);
+            p[1] = IntervalTimes(alo, bhi);
+            p[2] = IntervalTimes(ahi, blo);
+            p[3] = IntervalTimes(ahi, bhi);
+            *lo = *hi = p[0];
+            for(i = 1; i < 4; i++) {
+                *lo = min(*lo, p[i]);
+                *hi = max(*hi, p[i]);
+            }
+            break;
+
+        case NEGATE:
+            *lo = -ahi;
+            *hi = -alo;
+            break;
+
+        case SQUARE:
+            if(alo >= 0) {
+                *lo = alo*alo;
+                *hi = ahi*ahi;
+            } else if(ahi <= 0) {
+                *lo = ahi*ahi;
+                *hi = alo*alo;
+            } else {
+                *lo = 0;
+                *hi = max(alo*alo, ahi*ahi);
+            }
+            break;
+
+        case SQRT:
+            if(ahi < 0) {
+                // A NaN; not our problem here.
+                *lo = -HUGE_VAL;
+                *hi = HUGE_VAL;
+                break;
+            }
+            *lo = sqrt(max(alo, 0));
+            *hi = sqrt(ahi);
+            break;
+
+        case SIN:
+            IntervalSin(alo, ahi, lo, hi);
+            break;
+
+        case COS:
+            IntervalSin(alo + PI/2, ahi + PI/2, lo, hi);
+            break;
+
+        case ASIN:
+        case ACOS:
+            if(alo > 1 || ahi < -1) {
+                *lo = -HUGE_VAL;
+                *hi = HUGE_VAL;
+                break;
+            }
+            alo = max(alo, -1);
+            ahi = min(ahi, 1);
+            if(op == ASIN) {
+                *lo = asin(alo);
+                *hi = asin(ahi);
+            } else {
+                *lo = acos(ahi);
+                *hi = acos(alo);
+            }
+            break;
+
+        default: oops();
+    }
+
+    if(isnan(*lo)) *lo = -HUGE_VAL;
+    if(isnan(*hi)) *hi = HUGE_VAL;
+}
+
 QWORD Expr::ParamsUsed(void) {
     QWORD r = 0;
     if(op == PARAM)     r |= ((QWORD)1 << (x.parh.v % 61));
@@ -396,72 +644,187 @@ bool Expr::DependsOn(hParam p) {
 bool Expr::Tol(double a, double b) {
     return fabs(a - b) < 0.001;
 }
-Expr *Expr::FoldConstants(void) {
-    Expr *n = AllocExpr();
-    *n = *this;
 
+//-----------------------------------------------------------------------------
+// True if the two expressions certainly have the same value. We only look a
+// few levels down, so this can say no when they're in fact the same.
+//-----------------------------------------------------------------------------
+bool Expr::SameAs(Expr *e, int depth) {
+    if(this == e) return true;
+    if(op != e->op) return false;
+    switch(op) {
+        case PARAM:     return x.parh.v == e->x.parh.v;
+        case PARAM_PTR: return x.parp == e->x.parp;
+        case CONSTANT:  return x.v == e->x.v;
+    }
+    if(depth <= 0) return false;
     int c = Children();
-    if(c >= 1) n->a = a->FoldConstants();
-    if(c >= 2) n->b = b->FoldConstants();
+    if(c >= 1 && !a->SameAs(e->a, depth - 1)) return false;
+    if(c >= 2 && !b->SameAs(e->b, depth - 1)) return false;
+    return true;
+}
 
+// True if the expression can't be negative, for any values of the params.
+bool Expr::NonNegative(void) {
     switch(op) {
-        case PARAM_PTR:
-        case PARAM:
-        case CONSTANT:
+        case CONSTANT:  return x.v >= 0;
+        case SQRT:
+        case SQUARE:    return true;
+        case PLUS:
+        case TIMES:
+        case DIV:       return a->NonNegative() && b->NonNegative();
+        default:        return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Apply one simplification at this node, assuming that its children are
+// already simplified. Every rewrite keeps the value of the node the same,
+// so it's safe even if the node is shared with some other expression.
+// Returns true if it changed anything.
+//-----------------------------------------------------------------------------
+bool Expr::FoldStep(void) {
+    int c = Children();
+    bool ca = (c >= 1 && a->op == CONSTANT),
+         cb = (c >= 2 && b->op == CONSTANT);
+
+    if(c >= 1 && ca && (c == 1 || cb)) {
+        // Everything's known, so we can evaluate immediately
+        double nv = Eval();
+        op = CONSTANT;
+        x.v = nv;
+        return true;
+    }
+
+    Expr *t;
+    switch(op) {
+        case PLUS:
+            // Keep any constant on the right, so the rules below only
+            // need to look there.
+            if(ca) {
+                t = a; a = b; b = t; return true;
+            }
+            // x + 0 = x
+            if(cb && Tol(b->x.v, 0)) {
+                *this = *a; return true;
+            }
+            // x + -y = x - y
+            if(b->op == NEGATE) {
+                op = MINUS; b = b->a; return true;
+            }
+            // (x + c1) + c2 = x + (c1 + c2)
+            if(cb && a->op == PLUS && a->b->op == CONSTANT) {
+                b = From(a->b->x.v + b->x.v); a = a->a; return true;
+            }
             break;
 
         case MINUS:
-        case TIMES:
-        case DIV:
-        case PLUS:
-            // If both ops are known, then we can evaluate immediately
-            if(n->a->op == CONSTANT && n->b->op == CONSTANT) {
-                double nv = n->Eval();
-                n->op = CONSTANT;
-                n->x.v = nv;
-                break;
+            // x - 0 = x
+            if(cb && b->x.v == 0) {
+                *this = *a; return true;
+            }
+            // 0 - x = -x
+            if(ca && a->x.v == 0) {
+                op = NEGATE; a = b; b = NULL; return true;
+            }
+            // x - -y = x + y
+            if(b->op == NEGATE) {
+                op = PLUS; b = b->a; return true;
+            }
+            // x - x = 0
+            if(a->SameAs(b, 4)) {
+                op = CONSTANT; x.v = 0; return true;
             }
-            // x + 0 = 0 + x = x
-            if(op == PLUS && n->b->op == CONSTANT && Tol(n->b->x.v, 0)) {
-                *n = *(n->a); break;
+            break;
+
+        case TIMES:
+            if(ca) {
+                t = a; a = b; b = t; return true;
             }
-            if(op == PLUS && n->a->op == CONSTANT && Tol(n->a->x.v, 0)) {
-                *n = *(n->b); break;
+            // x*1 = x
+            if(cb && Tol(b->x.v, 1)) {
+                *this = *a; return true;
             }
-            // 1*x = x*1 = x
-            if(op == TIMES && n->b->op == CONSTANT && Tol(n->b->x.v, 1)) {
-                *n = *(n->a); break;
+            // x*0 = 0
+            if(cb && Tol(b->x.v, 0)) {
+                op = CONSTANT; x.v = 0; return true;
             }
-            if(op == TIMES && n->a->op == CONSTANT && Tol(n->a->x.v, 1)) {
-                *n = *(n->b); break;
+            // (x*c1)*c2 = x*(c1*c2)
+            if(cb && a->op == TIMES && a->b->op == CONSTANT) {
+                b = From(a->b->x.v * b->x.v); a = a->a; return true;
             }
-            // 0*x = x*0 = 0
-            if(op == TIMES && n->b->op == CONSTANT && Tol(n->b->x.v, 0)) {
-                n->op = CONSTANT; n->x.v = 0; break;
+            // (-x)*c = x*(-c)
+            if(cb && a->op == NEGATE) {
+                b = From(-(b->x.v)); a = a->a; return true;
             }
-            if(op == TIMES && n->a->op == CONSTANT && Tol(n->a->x.v, 0)) {
-                n->op = CONSTANT; n->x.v = 0; break;
+            break;
+
+        case DIV:
+            // x/1 = x
+            if(cb && b->x.v == 1) {
+                *this = *a; return true;
             }
+            break;
 
+        case NEGATE:
+            // --x = x
+            if(a->op == NEGATE) {
+                *this = *(a->a); return true;
+            }
+            // -(x - y) = y - x
+            if(a->op == MINUS) {
+                op = MINUS; b = a->a; a = a->b; return true;
+            }
             break;
 
         case SQRT:
+            // sqrt(x^2) = |x|, which is just x if x can't be negative
+            if(a->op == SQUARE && a->a->NonNegative()) {
+                *this = *(a->a); return true;
+            }
+            break;
+
         case SQUARE:
-        case NEGATE:
+            // (-x)^2 = x^2
+            if(a->op == NEGATE) {
+                a = a->a; return true;
+            }
+            // sqrt(x)^2 = x, if x can't be negative
+            if(a->op == SQRT && a->a->NonNegative()) {
+                *this = *(a->a); return true;
+            }
+            break;
+
+        case PARAM_PTR:
+        case PARAM:
+        case CONSTANT:
         case SIN:
         case COS:
         case ASIN:
         case ACOS:
-            if(n->a->op == CONSTANT) {
-                double nv = n->Eval();
-                n->op = CONSTANT;
-                n->x.v = nv;
-            }
             break;
 
         default: oops();
     }
-    return n;
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// Simplify the expression in place. This allocates nothing unless a rule
+// needs a new constant, and a node that's already been simplified (since
+// the partials share subexpressions with the function) is left alone.
+//-----------------------------------------------------------------------------
+Expr *Expr::FoldConstants(void) {
+    if(marker == FOLDED) return this;
+
+    int c = Children();
+    if(c >= 1) a->FoldConstants();
+    if(c >= 2) b->FoldConstants();
+
+    while(FoldStep())
+        ;
+    marker = FOLDED;
+    return this;
 }
 
 void Expr::Substitute(hParam oldh, hParam newh) {
@@ -572,48 +935,39 @@ p:
 // to provide calculator type functionality wherever numbers are entered.
 //-----------------------------------------------------------------------------
 
-#define MAX_UNPARSED 1024
-static Expr *Unparsed[MAX_UNPARSED];
-static int UnparsedCnt, UnparsedP;
-
-static Expr *Operands[MAX_UNPARSED];
-static int OperandsP;
-
-static Expr *Operators[MAX_UNPARSED];
-static int OperatorsP;
-
-void Expr::PushOperator(Expr *e) {
-    if(OperatorsP >= MAX_UNPARSED) throw "operator stack full!";
-    Operators[OperatorsP++] = e;
+void ExprParser::PushOperator(Expr *e) {
+    if(operatorsP >= MAX_UNPARSED) throw "operator stack full!";
+    operators[operatorsP++] = e;
 }
-Expr *Expr::TopOperator(void) {
-    if(OperatorsP <= 0) throw "operator stack empty (get top)";
-    return Operators[OperatorsP-1];
+Expr *ExprParser::TopOperator(void) {
+    if(operatorsP <= 0) throw "operator stack empty (get top)";
+    return operators[operatorsP-1];
 }
-Expr *Expr::PopOperator(void) {
-    if(OperatorsP <= 0) throw "operator stack empty (pop)";
-    return Operators[--OperatorsP];
+Expr *ExprParser::PopOperator(void) {
+    if(operatorsP <= 0) throw "operator stack empty (pop)";
+    return operators[--operatorsP];
 }
-void Expr::PushOperand(Expr *e) {
-    if(OperandsP >= MAX_UNPARSED) throw "operand stack full";
-    Operands[OperandsP++] = e;
+void ExprParser::PushOperand(Expr *e) {
+    if(operandsP >= MAX_UNPARSED) throw "operand stack full";
+    operands[operandsP++] = e;
 }
-Expr *Expr::PopOperand(void) {
-    if(OperandsP <= 0) throw "operand stack empty";
-    return Operands[--OperandsP];
+Expr *ExprParser::PopOperand(void) {
+    if(operandsP <= 0) throw "operand stack empty";
+    return operands[--operandsP];
 }
-Expr *Expr::Next(void) {
-    if(UnparsedP >= UnparsedCnt) return NULL;
-    return Unparsed[UnparsedP];
+Expr *ExprParser::Next(void) {
+    if(unparsedP >= unparsedCnt) return NULL;
+    return unparsed[unparsedP];
 }
-void Expr::Consume(void) {
-    if(UnparsedP >= UnparsedCnt) throw "no token to consume";
-    UnparsedP++;
+void ExprParser::Consume(void) {
+    if(unparsedP >= unparsedCnt) throw "no token to consume";
+    unparsedP++;
 }
 
-int Expr::Precedence(Expr *e) {
-    if(e->op == ALL_RESOLVED) return -1; // never want to reduce this marker
-    if(e->op != BINARY_OP && e->op != UNARY_OP) oops();
+int ExprParser::Precedence(Expr *e) {
+    // never want to reduce this marker
+    if(e->op == Expr::ALL_RESOLVED) return -1;
+    if(e->op != Expr::BINARY_OP && e->op != Expr::UNARY_OP) oops();
 
     switch(e->x.c) {
         case 'q':
@@ -631,17 +985,17 @@ int Expr::Precedence(Expr *e) {
     }
 }
 
-void Expr::Reduce(void) {
+void ExprParser::Reduce(void) {
     Expr *a, *b;
 
     Expr *op = PopOperator();
     Expr *n;
     int o;
     switch(op->x.c) {
-        case '+': o = PLUS;  goto c;
-        case '-': o = MINUS; goto c;
-        case '*': o = TIMES; goto c;
-        case '/': o = DIV;   goto c;
+        case '+': o = Expr::PLUS;  goto c;
+        case '-': o = Expr::MINUS; goto c;
+        case '*': o = Expr::TIMES; goto c;
+        case '/': o = Expr::DIV;   goto c;
 c:
             b = PopOperand();
             a = PopOperand();
@@ -658,39 +1012,41 @@ c:
     PushOperand(n);
 }
 
-void Expr::ReduceAndPush(Expr *n) {
+void ExprParser::ReduceAndPush(Expr *n) {
     while(Precedence(n) <= Precedence(TopOperator())) {
         Reduce();
     }
     PushOperator(n);
 }
 
-void Expr::Parse(void) {
-    Expr *e = AllocExpr();
-    e->op = ALL_RESOLVED;
+void ExprParser::Parse(void) {
+    Expr *e = Expr::AllocExpr();
+    e->op = Expr::ALL_RESOLVED;
     PushOperator(e);
 
     for(;;) {
         Expr *n = Next();
         if(!n) throw "end of expression unexpected";
         
-        if(n->op == CONSTANT) {
+        if(n->op == Expr::CONSTANT) {
             PushOperand(n);
             Consume();
-        } else if(n->op == PAREN && n->x.c == '(') {
+        } else if(n->op == Expr::PAREN && n->x.c == '(') {
             Consume();
             Parse();
             n = Next();
-            if(n->op != PAREN || n->x.c != ')') throw "expected: )";
+            if(!n || n->op != Expr::PAREN || n->x.c != ')') {
+                throw "expected: )";
+            }
             Consume();
-        } else if(n->op == UNARY_OP) {
+        } else if(n->op == Expr::UNARY_OP) {
             PushOperator(n);
             Consume();
             continue;
-        } else if(n->op == BINARY_OP && n->x.c == '-') {
+        } else if(n->op == Expr::BINARY_OP && n->x.c == '-') {
             // The minus sign is special, because it might be binary or
             // unary, depending on context.
-            n->op = UNARY_OP;
+            n->op = Expr::UNARY_OP;
             n->x.c = 'n';
             PushOperator(n);
             Consume();
@@ -700,7 +1056,7 @@ void Expr::Parse(void) {
         }
 
         n = Next();
-        if(n && n->op == BINARY_OP) {
+        if(n && n->op == Expr::BINARY_OP) {
             ReduceAndPush(n);
             Consume();
         } else {
@@ -708,15 +1064,15 @@ void Expr::Parse(void) {
         }
     }
 
-    while(TopOperator()->op != ALL_RESOLVED) {
+    while(TopOperator()->op != Expr::ALL_RESOLVED) {
         Reduce();
     }
-    PopOperator(); // discard the ALL_RESOLVED marker
+    PopOperator(); // discard the Expr::ALL_RESOLVED marker
 }
 
-void Expr::Lex(char *in) {
+void ExprParser::Lex(char *in) {
     while(*in) {
-        if(UnparsedCnt >= MAX_UNPARSED) throw "too long";
+        if(unparsedCnt >= MAX_UNPARSED) throw "too long";
 
         char c = *in;
         if(isdigit(c) || c == '.') {
@@ -728,10 +1084,10 @@ void Expr::Lex(char *in) {
                 in++;
             }
             number[len++] = '\0';
-            Expr *e = AllocExpr();
-            e->op = CONSTANT;
+            Expr *e = Expr::AllocExpr();
+            e->op = Expr::CONSTANT;
             e->x.v = atof(number);
-            Unparsed[UnparsedCnt++] = e;
+            unparsed[unparsedCnt++] = e;
         } else if(isalpha(c) || c == '_') {
             char name[70];
             int len = 0;
@@ -741,25 +1097,25 @@ void Expr::Lex(char *in) {
             }
             name[len++] = '\0';
 
-            Expr *e = AllocExpr();
+            Expr *e = Expr::AllocExpr();
             if(strcmp(name, "sqrt")==0) {
-                e->op = UNARY_OP;
+                e->op = Expr::UNARY_OP;
                 e->x.c = 'q';
             } else if(strcmp(name, "cos")==0) {
-                e->op = UNARY_OP;
+                e->op = Expr::UNARY_OP;
                 e->x.c = 'c';
             } else if(strcmp(name, "sin")==0) {
-                e->op = UNARY_OP;
+                e->op = Expr::UNARY_OP;
                 e->x.c = 's';
             } else {
                 throw "unknown name";
             }
-            Unparsed[UnparsedCnt++] = e;
+            unparsed[unparsedCnt++] = e;
         } else if(strchr("+-*/()", c)) {
-            Expr *e = AllocExpr();
-            e->op = (c == '(' || c == ')') ? PAREN : BINARY_OP;
+            Expr *e = Expr::AllocExpr();
+            e->op = (c == '(' || c == ')') ? Expr::PAREN : Expr::BINARY_OP;
             e->x.c = c;
-            Unparsed[UnparsedCnt++] = e;
+            unparsed[unparsedCnt++] = e;
             in++;
         } else if(isspace(c)) {
             // Ignore whitespace
@@ -771,24 +1127,62 @@ void Expr::Lex(char *in) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// The values of the strings that we've parsed recently. The expressions have
+// no variables, so the value is all that we need to remember, and a string
+// that's in here doesn't have to be lexed or parsed again.
+//
+// This is shared by every parse, with no locking, so Expr::From(char *) must
+// not be called from two threads at once. (Nor must anything else that makes
+// an Expr, since those come from the temporary heap, which isn't thread-safe
+// either.) Each parse's own stacks are in its ExprParser, so a parse doesn't
+// depend on any earlier one.
+//-----------------------------------------------------------------------------
+#define PARSE_CACHE_SIZE 256
+static struct {
+    char       *str;
+    double      v;
+} ParseCache[PARSE_CACHE_SIZE];
+
+static int ParseCacheSlot(char *in) {
+    DWORD h = 2166136261u;
+    char *s;
+    for(s = in; *s; s++) {
+        h = (h ^ (BYTE)*s)*16777619;
+    }
+    return (int)(h % PARSE_CACHE_SIZE);
+}
+
 Expr *Expr::From(char *in, bool popUpError) {
-    UnparsedCnt = 0;
-    UnparsedP = 0;
-    OperandsP = 0;
-    OperatorsP = 0;
+    int slot = ParseCacheSlot(in);
+    if(ParseCache[slot].str && strcmp(ParseCache[slot].str, in) == 0) {
+        return From(ParseCache[slot].v);
+    }
+
+    ExprParser p;
+    p.unparsedCnt = 0;
+    p.unparsedP = 0;
+    p.operandsP = 0;
+    p.operatorsP = 0;
 
     Expr *r;
     try {
-        Lex(in);
-        Parse();
-        r = PopOperand();
-    } catch (char *e) {
+        p.Lex(in);
+        p.Parse();
+        r = p.PopOperand();
+    } catch (const char *e) {
         dbp("exception: parse/lex error: %s", e);
         if(popUpError) {
             Error("Not a valid number or expression: '%s'", in);
         }
         return NULL;
     }
+
+    // Remember it; the only string that we drop is the one that was in
+    // this slot before.
+    if(ParseCache[slot].str) MemFree(ParseCache[slot].str);
+    ParseCache[slot].str = (char *)MemAlloc(strlen(in) + 1);
+    strcpy(ParseCache[slot].str, in);
+    ParseCache[slot].v = r->Eval();
     return r;
 }
-
@@ -13,6 +13,8 @@ class Expr;
 class Expr {
 public:
     DWORD marker;
+    // The marker of a node that FoldConstants() has already simplified
+    static const DWORD FOLDED = 0x464f4c44;
 
     // A parameter, by the hParam handle
     static const int PARAM          =  0;
@@ -83,9 +85,16 @@ public:
 
     Expr *PartialWrt(hParam p);
     double Eval(void);
+    // The most partials that EvalDual can find in one walk of the tree
+    static const int MAX_DUAL = 8;
+    double EvalDual(hParam *wrt, int n, double *d);
+    void EvalInterval(ParamList *unknown, double *lo, double *hi);
     QWORD ParamsUsed(void);
     bool DependsOn(hParam p);
     static bool Tol(double a, double b);
+    bool SameAs(Expr *e, int depth);
+    bool NonNegative(void);
+    bool FoldStep(void);
     Expr *FoldConstants(void);
     void Substitute(hParam oldh, hParam newh);
 
@@ -111,23 +120,135 @@ public:
     Expr *DeepCopyWithParamsAsPointers(IdList<Param,hParam> *firstTry,
         IdList<Param,hParam> *thenTry);
 
+    // Parse a string like "2*(3 + 4)"; not thread-safe, see expr.cpp.
     static Expr *From(char *in, bool popUpError);
-    static void  Lex(char *in);
-    static Expr *Next(void);
-    static void  Consume(void);
-
-    static void PushOperator(Expr *e);
-    static Expr *PopOperator(void);
-    static Expr *TopOperator(void);
-    static void PushOperand(Expr *e);
-    static Expr *PopOperand(void);
-
-    static void Reduce(void);
-    static void ReduceAndPush(Expr *e);
+};
+
+//-----------------------------------------------------------------------------
+// The state of a single parse, so that separate parses don't share anything.
+//-----------------------------------------------------------------------------
+class ExprParser {
+public:
+    static const int MAX_UNPARSED = 1024;
+
+    Expr   *unparsed[MAX_UNPARSED];
+    int     unparsedCnt, unparsedP;
+
+    Expr   *operands[MAX_UNPARSED];
+    int     operandsP;
+
+    Expr   *operators[MAX_UNPARSED];
+    int     operatorsP;
+
+    void  Lex(char *in);
+    Expr *Next(void);
+    void  Consume(void);
+
+    void  PushOperator(Expr *e);
+    Expr *PopOperator(void);
+    Expr *TopOperator(void);
+    void  PushOperand(Expr *e);
+    Expr *PopOperand(void);
+
+    void  Reduce(void);
+    void  ReduceAndPush(Expr *e);
     static int Precedence(Expr *e);
 
-    static int Precedence(int op);
-    static void Parse(void);
+    void  Parse(void);
+};
+
+//-----------------------------------------------------------------------------
+// Many expressions, compiled together in to straight-line code that writes
+// the value of each one to its own double. Identical subexpressions are
+// computed just once. On x86-64 this becomes native code, which is kept
+// and reused for any later program with exactly the same instructions (as
+// when we solve the same sketch again); elsewhere, we interpret it.
+//-----------------------------------------------------------------------------
+class ExprProgram {
+public:
+    static const int CONSTANT       =  0;
+    static const int LOAD           =  1;
+    static const int STORE          =  2;
+    static const int PLUS           = 10;
+    static const int MINUS          = 11;
+    static const int TIMES          = 12;
+    static const int DIV            = 13;
+    static const int NEGATE         = 20;
+    static const int SQRT           = 21;
+    static const int SQUARE         = 22;
+    static const int SIN            = 23;
+    static const int COS            = 24;
+    static const int ASIN           = 25;
+    static const int ACOS           = 26;
+
+    // Compute t[dest] from t[a] and t[b]; or for LOAD, t[dest] = *in[a],
+    // and for STORE, *out[b] = t[a].
+    typedef struct {
+        int     op;
+        int     dest;
+        int     a, b;
+    } Instr;
+
+    // An expression that's just a constant doesn't need any code.
+    typedef struct {
+        double *out;
+        double  v;
+    } ConstOut;
+
+    // Where a LOAD reads from, or a STORE writes to.
+    typedef struct {
+        double *p;
+    } Ptr;
+
+    List<Instr>     instr;
+    List<ConstOut>  constOut;
+    List<Ptr>       in;
+    List<Ptr>       out;
+    // The param that each in[] reads, so that a caller can point in[]
+    // somewhere else (like a batch of values for that param).
+    List<hParam>    inParam;
+
+    // The temporaries, one per distinct subexpression; the constants are
+    // written here once, when we compile.
+    double         *t;
+    int             tn;
+    int             tAllocated;
+
+    // While compiling, a hash table from each subexpression (op and
+    // operands) to its temporary.
+    typedef struct {
+        int     op;
+        int     a, b;
+        QWORD   bits;
+        int     slot;
+    } Key;
+    Key            *table;
+    int             tableSize;
+    int             tableUsed;
+
+    void           *native;
+    int             nativeLen;
+    int             cacheEntry;
+
+    // To evaluate at many operating points at once, each temporary gets
+    // one double per lane, so that the same op applies to all the lanes
+    // as a short loop that the compiler can vectorize.
+    static const int LANES = 8;
+    double         *tb;
+
+    void Add(Expr *e, double *out);
+    void Finish(void);
+    void Eval(void);
+    // Each in[] and out[] points to LANES consecutive doubles, and the
+    // program is evaluated for each lane.
+    void EvalBatch(void);
+    void Clear(void);
+
+    int Slot(Expr *e);
+    int Find(Key *k);
+    void Grow(void);
+    void Interpret(void);
+    bool Generate(void);
 };
 
 class ExprVector {
@@ -0,0 +1,530 @@
+//-----------------------------------------------------------------------------
+// Compile a set of expressions (usually the residuals or the Jacobian of
+// the system that we're solving) in to straight-line code, so that Newton's
+// method doesn't have to walk the expression trees at every iteration. On
+// x86-64, we generate native SSE2 code; otherwise, or if we can't get any
+// executable memory, we interpret the same instructions. The interpreter
+// can also run the program for several operating points at once.
+//
+// Copyright 2008-2013 Jonathan Westhues.
+//-----------------------------------------------------------------------------
+#include "solvespace.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(NO_JIT)
+#   define HAVE_JIT
+#endif
+
+// The native code is kept around, so that a later program with the same
+// instructions can just use it. A program holds a reference to the entry
+// that it's using, so we only ever throw out entries that nobody holds.
+#define CACHE_ENTRIES 16
+static struct {
+    DWORD                   hash;
+    ExprProgram::Instr     *instr;
+    int                     n;
+    void                   *code;
+    int                     len;
+    int                     refs;
+    DWORD                   lastUsed;
+} Cache[CACHE_ENTRIES];
+static DWORD CacheClock;
+
+void ExprProgram::Clear(void) {
+    if(native) {
+        if(cacheEntry >= 0) {
+            Cache[cacheEntry].refs--;
+        } else {
+            FreeExecutable(native, nativeLen);
+        }
+    }
+    native = NULL;
+    nativeLen = 0;
+    cacheEntry = -1;
+
+    instr.Clear();
+    constOut.Clear();
+    in.Clear();
+    out.Clear();
+    inParam.Clear();
+    if(t) MemFree(t);
+    if(tb) MemFree(tb);
+    tb = NULL;
+    t = NULL;
+    tn = tAllocated = 0;
+    if(table) MemFree(table);
+    table = NULL;
+    tableSize = tableUsed = 0;
+}
+
+//-----------------------------------------------------------------------------
+// The hash table of subexpressions that we've already got a temporary for.
+// Returns the index of that key in the table, or of the empty entry where
+// it should go.
+//-----------------------------------------------------------------------------
+int ExprProgram::Find(Key *k) {
+    DWORD h = (DWORD)k->op*31 + (DWORD)k->a*1000003 + (DWORD)k->b*8191 +
+              (DWORD)(k->bits ^ (k->bits >> 32))*2654435761u;
+    int i = (int)(h & (tableSize - 1));
+    for(;;) {
+        Key *e = &(table[i]);
+        if(e->slot < 0) return i;
+        if(e->op == k->op && e->a == k->a && e->b == k->b &&
+           e->bits == k->bits)
+        {
+            return i;
+        }
+        i = (i + 1) & (tableSize - 1);
+    }
+}
+
+void ExprProgram::Grow(void) {
+    Key *old = table;
+    int oldSize = tableSize, i;
+
+    tableSize = max(2*tableSize, 256);
+    table = (Key *)MemAlloc(tableSize*sizeof(Key));
+    for(i = 0; i < tableSize; i++) {
+        table[i].slot = -1;
+    }
+    for(i = 0; i < oldSize; i++) {
+        if(old[i].slot < 0) continue;
+        table[Find(&(old[i]))] = old[i];
+    }
+    if(old) MemFree(old);
+}
+
+//-----------------------------------------------------------------------------
+// Return the temporary that holds the value of e, writing the instructions
+// to compute it if we don't already have it.
+//-----------------------------------------------------------------------------
+int ExprProgram::Slot(Expr *e) {
+    Key k;
+    ZERO(&k);
+    double *p = NULL;
+    switch(e->op) {
+        case Expr::PARAM:
+            p = &(SK.GetParam(e->x.parh)->val);
+            k.op = LOAD;
+            k.bits = (QWORD)p;
+            break;
+        case Expr::PARAM_PTR:
+            p = &(e->x.parp->val);
+            k.op = LOAD;
+            k.bits = (QWORD)p;
+            break;
+
+        case Expr::CONSTANT:
+            k.op = CONSTANT;
+            memcpy(&(k.bits), &(e->x.v), sizeof(k.bits));
+            break;
+
+        case Expr::PLUS:    k.op = PLUS;    goto binary;
+        case Expr::MINUS:   k.op = MINUS;   goto binary;
+        case Expr::TIMES:   k.op = TIMES;   goto binary;
+        case Expr::DIV:     k.op = DIV;     goto binary;
+binary:
+            k.a = Slot(e->a);
+            k.b = Slot(e->b);
+            break;
+
+        case Expr::NEGATE:  k.op = NEGATE;  goto unary;
+        case Expr::SQRT:    k.op = SQRT;    goto unary;
+        case Expr::SQUARE:  k.op = SQUARE;  goto unary;
+        case Expr::SIN:     k.op = SIN;     goto unary;
+        case Expr::COS:     k.op = COS;     goto unary;
+        case Expr::ASIN:    k.op = ASIN;    goto unary;
+        case Expr::ACOS:    k.op = ACOS;    goto unary;
+unary:
+            k.a = Slot(e->a);
+            break;
+
+        default: oops();
+    }
+
+    if(2*(tableUsed + 1) > tableSize) Grow();
+    int i = Find(&k);
+    if(table[i].slot >= 0) return table[i].slot;
+
+    if(tn >= tAllocated) {
+        tAllocated = (tAllocated + 32)*2;
+        t = (double *)MemRealloc(t, tAllocated*sizeof(double));
+    }
+    int s = tn++;
+    t[s] = 0;
+
+    if(k.op == CONSTANT) {
+        t[s] = e->x.v;
+    } else {
+        Instr in;
+        in.op = k.op;
+        in.dest = s;
+        in.a = k.a;
+        in.b = k.b;
+        if(k.op == LOAD) {
+            Ptr ip = { p };
+            this->in.Add(&ip);
+            inParam.Add(e->op == Expr::PARAM ? &(e->x.parh) :
+                                               &(e->x.parp->h));
+            in.a = this->in.n - 1;
+        }
+        instr.Add(&in);
+    }
+
+    k.slot = s;
+    table[i] = k;
+    tableUsed++;
+    return s;
+}
+
+//-----------------------------------------------------------------------------
+// Add an expression to the program; Eval() will write its value to *o.
+//-----------------------------------------------------------------------------
+void ExprProgram::Add(Expr *e, double *o) {
+    if(e->op == Expr::CONSTANT) {
+        ConstOut co;
+        co.out = o;
+        co.v = e->x.v;
+        constOut.Add(&co);
+        return;
+    }
+
+    Instr st;
+    st.op = STORE;
+    st.dest = 0;
+    st.a = Slot(e);
+    Ptr op = { o };
+    out.Add(&op);
+    st.b = out.n - 1;
+    instr.Add(&st);
+}
+
+//-----------------------------------------------------------------------------
+// Done adding expressions, so generate the native code if we can.
+//-----------------------------------------------------------------------------
+void ExprProgram::Finish(void) {
+    if(table) MemFree(table);
+    table = NULL;
+    tableSize = tableUsed = 0;
+
+#ifdef HAVE_JIT
+    if(instr.n == 0) return;
+
+    DWORD h = 2166136261u;
+    BYTE *b = (BYTE *)instr.elem;
+    int i, n = instr.n*sizeof(Instr);
+    for(i = 0; i < n; i++) {
+        h = (h ^ b[i])*16777619;
+    }
+
+    CacheClock++;
+    for(i = 0; i < CACHE_ENTRIES; i++) {
+        if(Cache[i].code && Cache[i].hash == h && Cache[i].n == instr.n &&
+           memcmp(Cache[i].instr, instr.elem, n) == 0)
+        {
+            Cache[i].refs++;
+            Cache[i].lastUsed = CacheClock;
+            native = Cache[i].code;
+            nativeLen = Cache[i].len;
+            cacheEntry = i;
+            return;
+        }
+    }
+
+    if(!Generate()) return;
+
+    // Put it in the cache, in place of the least recently used entry that
+    // nobody else is using; or if there's no such entry, just keep it.
+    int best = -1;
+    for(i = 0; i < CACHE_ENTRIES; i++) {
+        if(Cache[i].refs > 0) continue;
+        if(best < 0 || Cache[i].lastUsed < Cache[best].lastUsed) best = i;
+    }
+    if(best < 0) return;
+
+    if(Cache[best].code) {
+        FreeExecutable(Cache[best].code, Cache[best].len);
+        MemFree(Cache[best].instr);
+    }
+    Cache[best].hash = h;
+    Cache[best].n = instr.n;
+    Cache[best].instr = (Instr *)MemAlloc(n);
+    memcpy(Cache[best].instr, instr.elem, n);
+    Cache[best].code = native;
+    Cache[best].len = nativeLen;
+    Cache[best].refs = 1;
+    Cache[best].lastUsed = CacheClock;
+    cacheEntry = best;
+#endif
+}
+
+void ExprProgram::Eval(void) {
+    int i;
+    for(i = 0; i < constOut.n; i++) {
+        *(constOut.elem[i].out) = constOut.elem[i].v;
+    }
+
+    if(native) {
+        typedef void NativeFn(double *t, Ptr *in, Ptr *out);
+        ((NativeFn *)native)(t, in.elem, out.elem);
+    } else {
+        Interpret();
+    }
+}
+
+void ExprProgram::Interpret(void) {
+    Instr *in = instr.elem, *end = instr.elem + instr.n;
+    for(; in < end; in++) {
+        double *d = &(t[in->dest]), a = t[in->a];
+        switch(in->op) {
+            case LOAD:      *d = *(this->in.elem[in->a].p); break;
+            case STORE:     *(out.elem[in->b].p) = a; break;
+
+            case PLUS:      *d = a + t[in->b]; break;
+            case MINUS:     *d = a - t[in->b]; break;
+            case TIMES:     *d = a * t[in->b]; break;
+            case DIV:       *d = a / t[in->b]; break;
+
+            case NEGATE:    *d = -a; break;
+            case SQRT:      *d = sqrt(a); break;
+            case SQUARE:    *d = a*a; break;
+            case SIN:       *d = sin(a); break;
+            case COS:       *d = cos(a); break;
+            case ASIN:      *d = asin(a); break;
+            case ACOS:      *d = acos(a); break;
+
+            default: oops();
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// The ops on all the lanes at once. Each lane array is a different
+// temporary (or the caller's buffer), so the output never overlaps the
+// inputs, and there are always LANES of them; so with the __restrict, these
+// are straight-line vector code. The library functions (sqrt, which may set
+// errno, and the trig) stay scalar.
+//-----------------------------------------------------------------------------
+#define LANE_OP1(name, x) \
+    static void name(double *__restrict d, const double *__restrict a) { \
+        int k; \
+        for(k = 0; k < ExprProgram::LANES; k++) d[k] = (x); \
+    }
+#define LANE_OP2(name, x) \
+    static void name(double *__restrict d, const double *__restrict a, \
+                     const double *__restrict b) { \
+        int k; \
+        for(k = 0; k < ExprProgram::LANES; k++) d[k] = (x); \
+    }
+LANE_OP1(LanesCopy,     a[k])
+LANE_OP2(LanesPlus,     a[k] + b[k])
+LANE_OP2(LanesMinus,    a[k] - b[k])
+LANE_OP2(LanesTimes,    a[k] * b[k])
+LANE_OP2(LanesDiv,      a[k] / b[k])
+LANE_OP1(LanesNegate,   -a[k])
+LANE_OP1(LanesSqrt,     sqrt(a[k]))
+LANE_OP1(LanesSquare,   a[k]*a[k])
+LANE_OP1(LanesSin,      sin(a[k]))
+LANE_OP1(LanesCos,      cos(a[k]))
+LANE_OP1(LanesAsin,     asin(a[k]))
+LANE_OP1(LanesAcos,     acos(a[k]))
+#undef LANE_OP1
+#undef LANE_OP2
+
+void ExprProgram::EvalBatch(void) {
+    int i, k;
+    for(i = 0; i < constOut.n; i++) {
+        double *o = constOut.elem[i].out, v = constOut.elem[i].v;
+        for(k = 0; k < LANES; k++) o[k] = v;
+    }
+
+    if(!tb) {
+        // Set up the temporaries; the constants are the same in every
+        // lane, and everything else gets written before it's read.
+        tb = (double *)MemAlloc(max(tn*LANES, 1)*sizeof(double));
+        for(i = 0; i < tn; i++) {
+            for(k = 0; k < LANES; k++) tb[i*LANES + k] = t[i];
+        }
+    }
+
+    Instr *in = instr.elem, *end = instr.elem + instr.n;
+    for(; in < end; in++) {
+        double *d = &(tb[in->dest*LANES]),
+               *a = &(tb[in->a*LANES]),
+               *b = &(tb[in->b*LANES]);
+        switch(in->op) {
+            case LOAD:      LanesCopy(d, this->in.elem[in->a].p); break;
+            case STORE:     LanesCopy(out.elem[in->b].p, a); break;
+
+            case PLUS:      LanesPlus(d, a, b); break;
+            case MINUS:     LanesMinus(d, a, b); break;
+            case TIMES:     LanesTimes(d, a, b); break;
+            case DIV:       LanesDiv(d, a, b); break;
+
+            case NEGATE:    LanesNegate(d, a); break;
+            case SQRT:      LanesSqrt(d, a); break;
+            case SQUARE:    LanesSquare(d, a); break;
+            case SIN:       LanesSin(d, a); break;
+            case COS:       LanesCos(d, a); break;
+            case ASIN:      LanesAsin(d, a); break;
+            case ACOS:      LanesAcos(d, a); break;
+
+            default: oops();
+        }
+    }
+}
+
+#ifdef HAVE_JIT
+//-----------------------------------------------------------------------------
+// The x86-64 code generator. The generated function is
+//      void f(double *t, Ptr *in, Ptr *out)
+// and keeps t in rbx, in in r12, and out in r13, working in xmm0.
+//-----------------------------------------------------------------------------
+static BYTE *Code;
+static int CodeLen, CodeAllocated;
+
+static void B(int b) {
+    if(CodeLen >= CodeAllocated) {
+        CodeAllocated = (CodeAllocated + 1024)*2;
+        Code = (BYTE *)MemRealloc(Code, CodeAllocated);
+    }
+    Code[CodeLen++] = (BYTE)b;
+}
+static void B(int b0, int b1) { B(b0); B(b1); }
+static void B(int b0, int b1, int b2) { B(b0); B(b1); B(b2); }
+static void B(int b0, int b1, int b2, int b3) { B(b0); B(b1); B(b2); B(b3); }
+static void Dword(DWORD v) {
+    int i;
+    for(i = 0; i < 4; i++) B((v >> (8*i)) & 0xff);
+}
+static void Qword(QWORD v) {
+    Dword((DWORD)(v & 0xffffffff));
+    Dword((DWORD)(v >> 32));
+}
+
+// An SSE2 instruction between xmm0 and [rbx + 8*slot], like movsd or addsd
+static void SseTemp(int opcode, int slot) {
+    B(0xf2, 0x0f, opcode, 0x83);
+    Dword(8*slot);
+}
+static void LoadTemp(int slot)  { SseTemp(0x10, slot); }
+static void StoreTemp(int slot) { SseTemp(0x11, slot); }
+
+static void CallMath(double (*f)(double)) {
+    B(0x48, 0xb8);              // mov rax, f
+    Qword((QWORD)f);
+    B(0xff, 0xd0);              // call rax
+}
+
+bool ExprProgram::Generate(void) {
+    CodeLen = 0;
+
+    B(0x53);                    // push rbx
+    B(0x41, 0x54);              // push r12
+    B(0x41, 0x55);              // push r13
+#ifdef WIN32
+    B(0x48, 0x83, 0xec, 0x20);  // sub rsp, 32 (shadow space for calls)
+    B(0x48, 0x89, 0xcb);        // mov rbx, rcx
+    B(0x49, 0x89, 0xd4);        // mov r12, rdx
+    B(0x4d, 0x89, 0xc5);        // mov r13, r8
+#else
+    B(0x48, 0x89, 0xfb);        // mov rbx, rdi
+    B(0x49, 0x89, 0xf4);        // mov r12, rsi
+    B(0x49, 0x89, 0xd5);        // mov r13, rdx
+#endif
+
+    int i;
+    for(i = 0; i < instr.n; i++) {
+        Instr *in = &(instr.elem[i]);
+        switch(in->op) {
+            case LOAD:
+                B(0x49, 0x8b, 0x84, 0x24);  // mov rax, [r12 + 8*a]
+                Dword(8*in->a);
+                B(0xf2, 0x0f, 0x10, 0x00);  // movsd xmm0, [rax]
+                StoreTemp(in->dest);
+                break;
+
+            case STORE:
+                B(0x49, 0x8b, 0x85);        // mov rax, [r13 + 8*b]
+                Dword(8*in->b);
+                LoadTemp(in->a);
+                B(0xf2, 0x0f, 0x11, 0x00);  // movsd [rax], xmm0
+                break;
+
+            case PLUS:
+            case MINUS:
+            case TIMES:
+            case DIV: {
+                int opcode = (in->op == PLUS)  ? 0x58 :
+                             (in->op == MINUS) ? 0x5c :
+                             (in->op == TIMES) ? 0x59 : 0x5e;
+                LoadTemp(in->a);
+                SseTemp(opcode, in->b);
+                StoreTemp(in->dest);
+                break;
+            }
+
+            case NEGATE:
+                // Flip the sign bit, so that we get -0 right.
+                B(0x48, 0x8b, 0x83);        // mov rax, [rbx + 8*a]
+                Dword(8*in->a);
+                B(0x48, 0x0f, 0xba, 0xf8);  // btc rax, 63
+                B(0x3f);
+                B(0x48, 0x89, 0x83);        // mov [rbx + 8*dest], rax
+                Dword(8*in->dest);
+                break;
+
+            case SQRT:
+                SseTemp(0x51, in->a);       // sqrtsd xmm0, [rbx + 8*a]
+                StoreTemp(in->dest);
+                break;
+
+            case SQUARE:
+                LoadTemp(in->a);
+                B(0xf2, 0x0f, 0x59, 0xc0);  // mulsd xmm0, xmm0
+                StoreTemp(in->dest);
+                break;
+
+            case SIN:
+            case COS:
+            case ASIN:
+            case ACOS: {
+                double (*f)(double) =
+                    (in->op == SIN)  ? (double (*)(double))sin  :
+                    (in->op == COS)  ? (double (*)(double))cos  :
+                    (in->op == ASIN) ? (double (*)(double))asin :
+                                       (double (*)(double))acos;
+                LoadTemp(in->a);
+                CallMath(f);
+                StoreTemp(in->dest);
+                break;
+            }
+
+            default: oops();
+        }
+    }
+
+#ifdef WIN32
+    B(0x48, 0x83, 0xc4, 0x20);  // add rsp, 32
+#endif
+    B(0x41, 0x5d);              // pop r13
+    B(0x41, 0x5c);              // pop r12
+    B(0x5b);                    // pop rbx
+    B(0xc3);                    // ret
+
+    void *p = AllocExecutable(CodeLen);
+    if(!p) return false;
+    memcpy(p, Code, CodeLen);
+    if(!MakeExecutable(p, CodeLen)) {
+        FreeExecutable(p, CodeLen);
+        return false;
+    }
+    native = p;
+    nativeLen = CodeLen;
+    cacheEntry = -1;
+    return true;
+}
+#else
+bool ExprProgram::Generate(void) {
+    return false;
+}
+#endif
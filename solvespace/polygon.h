@@ -143,6 +143,7 @@ public:
     void OffsetInto(SPolygon *dest, double r);
     void UvTriangulateInto(SMesh *m, SSurface *srf);
     void UvGridTriangulateInto(SMesh *m, SSurface *srf);
+    bool SweepTriangulateInto(SMesh *m, SSurface *srf);
 };
 
 class STriangle {
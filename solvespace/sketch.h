@@ -19,6 +19,7 @@ class hEquation;
 class Entity;
 class Param;
 class Equation;
+class CoincidentIndex;
 
 
 // All of the hWhatever handles are a 32-bit ID, that is used to represent
@@ -413,7 +414,8 @@ public:
     Vector EndpointFinish();
 
     void AddEq(IdList<Equation,hEquation> *l, Expr *expr, int index);
-    void GenerateEquations(IdList<Equation,hEquation> *l);
+    void GenerateEquations(IdList<Equation,hEquation> *l,
+                           CoincidentIndex *coincident);
 };
 
 class Entity : public EntityBase {
@@ -560,6 +562,9 @@ public:
 
     // These are the parameters for the constraint.
     double      valA;
+    // If set, a param that holds valA, so that the equations refer to that
+    // param instead of baking in the number.
+    hParam      valAParam;
     hEntity     ptA;
     hEntity     ptB;
     hEntity     entityA;
@@ -576,6 +581,8 @@ public:
 
     void Generate(IdList<Equation,hEquation> *l);
     void GenerateReal(IdList<Equation,hEquation> *l);
+    bool GenerateFromTemplate(IdList<Equation,hEquation> *l);
+    bool EquationsDependOnValues(void);
     // Some helpers when generating symbolic constraint equations
     void ModifyToSatisfy(void);
     void AddEq(IdList<Equation,hEquation> *l, Expr *expr, int index);
@@ -638,6 +645,22 @@ public:
                                     bool other, bool other2);
 };
 
+// The point-coincident constraints in a group, by the pair of points, so
+// that we can ask whether two points are constrained coincident without
+// looking at every constraint in the sketch.
+class PointPair {
+public:
+    hEntity     a, b;   // with a.v <= b.v
+};
+class CoincidentIndex {
+public:
+    List<PointPair>     pair;   // sorted
+
+    void Build(hGroup hg);
+    bool Contains(hEntity a, hEntity b);
+    void Clear(void);
+};
+
 class hEquation {
 public:
     DWORD v;
@@ -177,6 +177,7 @@ void PaintGraphics(void);
 void GetGraphicsWindowSize(int *w, int *h);
 void GetTextWindowSize(int *w, int *h);
 SDWORD GetMilliseconds(void);
+SQWORD GetMicroseconds(void);
 SQWORD GetUnixTime(void);
 
 void dbp(char *str, ...);
@@ -207,9 +208,13 @@ float CnfThawFloat(float v, char *name);
 void *AllocTemporary(int n);
 void FreeTemporary(void *p);
 void FreeAllTemporary(void);
+QWORD TemporaryBytesAllocated(void);
 void *MemRealloc(void *p, int n);
 void *MemAlloc(int n);
 void MemFree(void *p);
+void *AllocExecutable(int n);
+bool MakeExecutable(void *p, int n);
+void FreeExecutable(void *p, int n);
 void InitHeaps(void);
 void vl(void); // debug function to validate heaps
 
@@ -346,21 +351,87 @@ public:
 
     bool WriteJacobian(int tag);
     void EvalJacobian(void);
+    // For a small enough block, we find the Jacobian by forward-mode
+    // automatic differentiation instead, and never build the partials.
+    bool            dual;
+
+    // For the big system, Newton's method evaluates the same Jacobian and
+    // residuals many times, so we compile them once to straight-line code.
+    ExprProgram     jacobianProgram;
+    ExprProgram     residualProgram;
+    bool            compiled;
+    void CompileJacobian(void);
+    void EvalResiduals(void);
 
     void WriteEquationsExceptFor(hConstraint hc, Group *g);
     void FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad);
+    bool FindImpossibleEquations(List<hConstraint> *bad);
     void SolveBySubstitution(void);
 
     bool IsDragged(hParam p);
 
     bool NewtonSolve(int tag);
 
+    // The caller may give the solver a deadline (in GetMilliseconds()
+    // time), or a flag that some other thread sets to ask us to stop. We
+    // check those between iterations; once either is hit, timedOut is set
+    // and the solve returns TIMED_OUT as soon as it can.
+    bool            haveDeadline;
+    SDWORD          deadline;
+    volatile int   *cancel;
+    bool            timedOut;
+    bool CheckTimedOut(void);
+
+    // If stats is non-NULL, then we add to it where the time went (in
+    // microseconds, by phase of the solve) and how big the problem was.
+    class Stats {
+    public:
+        SQWORD      generateTime;
+        SQWORD      substituteTime;
+        SQWORD      jacobianTime;
+        SQWORD      rankTime;
+        SQWORD      newtonTime;
+        SQWORD      diagnoseTime;
+
+        int         equations, params;
+        int         equationsLeft, paramsLeft;
+        int         exprNodes;
+
+        int         iterations;
+        // Iteration count for each Newton solve, up to blockSpace of them
+        int        *blockIterations;
+        int         blockSpace;
+        int         blocks;
+    };
+    Stats          *stats;
+    SQWORD StartTimer(void);
+
+    bool PredictContinuation(Group *g, ConstraintBase *c, double vnext);
+
+    // What Solve wrote, so that we can solve the same equations again for
+    // new values of the params (or of a constraint's valAParam): each
+    // block that it solved alone, and the Jacobian for the big system.
+    typedef struct {
+        int         tag;
+        hParam      param;
+        hEquation   eq;
+        Expr       *f;
+    } AloneBlock;
+    List<AloneBlock>                aloneBlock;
+    bool                            canSolveAgain;
+    int SolveWrittenJacobian(Group *g, int *dof, List<hConstraint> *bad,
+                             bool andFindBad, bool andFindFree);
+    int ReportTimedOut(void);
+    int ReportDidntConverge(List<hConstraint> *bad);
+
     static const int SOLVED_OKAY          = 0;
     static const int DIDNT_CONVERGE       = 10;
     static const int SINGULAR_JACOBIAN    = 11;
+    static const int TIMED_OUT            = 12;
     static const int TOO_MANY_UNKNOWNS    = 20;
     int Solve(Group *g, int *dof, List<hConstraint> *bad,
                 bool andFindBad, bool andFindFree);
+    int SolveAgain(int *dof, List<hConstraint> *bad);
 };
 
 class TtfFont {
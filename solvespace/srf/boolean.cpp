@@ -418,7 +418,8 @@ void SSurface::EdgeNormalsWithinSurface(Point2d auv, Point2d buv,
 SSurface SSurface::MakeCopyTrimAgainst(SShell *parent,
                                        SShell *sha, SShell *shb,
                                        SShell *into,
-                                       int type)
+                                       int type,
+                                       SInterCurve *ic, int icn)
 {
     bool opA = (parent == sha);
     SShell *agnst = opA ? shb : sha;
@@ -427,6 +428,7 @@ SSurface SSurface::MakeCopyTrimAgainst(SShell *parent,
     // The returned surface is identical, just the trim curves change
     ret = *this;
     ZERO(&(ret.trim));
+    ret.samples = NULL;
 
     // First, build a list of the existing trim curves; update them to use
     // the split curves.
@@ -452,51 +454,44 @@ SSurface SSurface::MakeCopyTrimAgainst(SShell *parent,
     // which means that we can't necessarily use the old BSP...
     SBspUv *origBsp = SBspUv::From(&orig, &ret);
 
-    // And now intersect the other shell against us
+    // And now intersect the other shell against us; those are the curves
+    // that our caller listed for us.
     SEdgeList inter;
     ZERO(&inter);
 
-    SSurface *ss;
-    for(ss = agnst->surface.First(); ss; ss = agnst->surface.NextAfter(ss)) {
-        SCurve *sc;
-        for(sc = into->curve.First(); sc; sc = into->curve.NextAfter(sc)) {
-            if(sc->source != SCurve::FROM_INTERSECTION) continue;
-            if(opA) {
-                if(sc->surfA.v != h.v || sc->surfB.v != ss->h.v) continue;
-            } else {
-                if(sc->surfB.v != h.v || sc->surfA.v != ss->h.v) continue;
-            }
-           
-            int i;
-            for(i = 1; i < sc->pts.n; i++) {
-                Vector a = sc->pts.elem[i-1].p,
-                       b = sc->pts.elem[i].p;
-
-                Point2d auv, buv;
-                ss->ClosestPointTo(a, &(auv.x), &(auv.y));
-                ss->ClosestPointTo(b, &(buv.x), &(buv.y));
-
-                int c = ss->bsp->ClassifyEdge(auv, buv, ss);
-                if(c != SBspUv::OUTSIDE) {
-                    Vector ta = Vector::From(0, 0, 0);
-                    Vector tb = Vector::From(0, 0, 0);
-                    ret.ClosestPointTo(a, &(ta.x), &(ta.y));
-                    ret.ClosestPointTo(b, &(tb.x), &(tb.y));
-
-                    Vector tn = ret.NormalAt(ta.x, ta.y);
-                    Vector sn = ss->NormalAt(auv.x, auv.y);
-
-                    // We are subtracting the portion of our surface that
-                    // lies in the shell, so the in-plane edge normal should
-                    // point opposite to the surface normal.
-                    bool bkwds = true;
-                    if((tn.Cross(b.Minus(a))).Dot(sn) < 0) bkwds = !bkwds;
-                    if(type == SShell::AS_DIFFERENCE && !opA) bkwds = !bkwds;
-                    if(bkwds) {
-                        inter.AddEdge(tb, ta, sc->h.v, 1);
-                    } else { 
-                        inter.AddEdge(ta, tb, sc->h.v, 0);
-                    }
+    int ici;
+    for(ici = 0; ici < icn; ici++) {
+        SSurface *ss = ic[ici].ss;
+        SCurve *sc = &(into->curve.elem[ic[ici].curve]);
+        int i;
+        for(i = 1; i < sc->pts.n; i++) {
+            Vector a = sc->pts.elem[i-1].p,
+                   b = sc->pts.elem[i].p;
+
+            Point2d auv, buv;
+            ss->ClosestPointTo(a, &(auv.x), &(auv.y));
+            ss->ClosestPointTo(b, &(buv.x), &(buv.y));
+
+            int c = ss->bsp->ClassifyEdge(auv, buv, ss);
+            if(c != SBspUv::OUTSIDE) {
+                Vector ta = Vector::From(0, 0, 0);
+                Vector tb = Vector::From(0, 0, 0);
+                ret.ClosestPointTo(a, &(ta.x), &(ta.y));
+                ret.ClosestPointTo(b, &(tb.x), &(tb.y));
+
+                Vector tn = ret.NormalAt(ta.x, ta.y);
+                Vector sn = ss->NormalAt(auv.x, auv.y);
+
+                // We are subtracting the portion of our surface that
+                // lies in the shell, so the in-plane edge normal should
+                // point opposite to the surface normal.
+                bool bkwds = true;
+                if((tn.Cross(b.Minus(a))).Dot(sn) < 0) bkwds = !bkwds;
+                if(type == SShell::AS_DIFFERENCE && !opA) bkwds = !bkwds;
+                if(bkwds) {
+                    inter.AddEdge(tb, ta, sc->h.v, 1);
+                } else { 
+                    inter.AddEdge(ta, tb, sc->h.v, 0);
                 }
             }
         }
@@ -627,36 +622,112 @@ SSurface SSurface::MakeCopyTrimAgainst(SShell *parent,
     return ret;
 }
 
+//-----------------------------------------------------------------------------
+// List the intersection curves by the surface that they trim, then by the
+// surface from the other shell, then in their order in the result; so each
+// surface gets its own curves, in the same order as if it tried every
+// surface and curve.
+//-----------------------------------------------------------------------------
+static int ByTrimmedSurface(const void *av, const void *bv) {
+    const SInterCurve *a = (const SInterCurve *)av,
+                      *b = (const SInterCurve *)bv;
+    if(a->srf != b->srf) return (a->srf < b->srf) ? -1 : 1;
+    if(a->other != b->other) return (a->other < b->other) ? -1 : 1;
+    if(a->curve != b->curve) return (a->curve < b->curve) ? -1 : 1;
+    return 0;
+}
+
 void SShell::CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into,
                                         int type)
 {
+    bool opA = (this == sha);
+    SShell *agnst = opA ? shb : sha;
+
+    List<SInterCurve> icl;
+    ZERO(&icl);
+    int i;
+    for(i = 0; i < into->curve.n; i++) {
+        SCurve *sc = &(into->curve.elem[i]);
+        if(sc->source != SCurve::FROM_INTERSECTION) continue;
+
+        SInterCurve ic;
+        ic.srf   = opA ? sc->surfA.v : sc->surfB.v;
+        ic.other = opA ? sc->surfB.v : sc->surfA.v;
+        ic.curve = i;
+        ic.ss    = agnst->surface.FindByIdNoOops(opA ? sc->surfB : sc->surfA);
+        if(!ic.ss) continue;
+        icl.Add(&ic);
+    }
+    qsort(icl.elem, icl.n, sizeof(icl.elem[0]), ByTrimmedSurface);
+
     SSurface *ss;
+    int ici = 0;
     for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
+        while(ici < icl.n && icl.elem[ici].srf < ss->h.v) ici++;
+        int icn = 0;
+        while(ici + icn < icl.n && icl.elem[ici + icn].srf == ss->h.v) icn++;
+
         SSurface ssn;
-        ssn = ss->MakeCopyTrimAgainst(this, sha, shb, into, type);
+        ssn = ss->MakeCopyTrimAgainst(this, sha, shb, into, type,
+                                      &(icl.elem[ici]), icn);
         ss->newH = into->surface.AddAndAssignId(&ssn);
         I++;
     }
+    icl.Clear();
 }
 
 void SShell::MakeIntersectionCurvesAgainst(SShell *agnst, SShell *into) {
+    // Surfaces can intersect only if their bounding boxes do, so we look
+    // up the candidates in a hierarchy of boxes, instead of trying every
+    // pair.
+    SBvh *bvh = agnst->bvh ? agnst->bvh : SBvh::From(agnst);
+    List<SIndex> near;
+    ZERO(&near);
+
+    // An exact curve that we find follows the piecewise linearization of
+    // any identical curve that's already in into, so index those.
+    SCurveIndex exact;
+    ZERO(&exact);
+    SCurve *sc;
+    for(sc = into->curve.First(); sc; sc = into->curve.NextAfter(sc)) {
+        if(sc->isExact) exact.Add(sc);
+    }
+    into->exactCurves = &exact;
+
     SSurface *sa;
     for(sa = surface.First(); sa; sa = surface.NextAfter(sa)) {
-        SSurface *sb;
-        for(sb = agnst->surface.First(); sb; sb = agnst->surface.NextAfter(sb)){
-            // Intersect every surface from our shell against every surface
+        Vector amax, amin;
+        sa->GetAxisAlignedBounding(&amax, &amin);
+
+        // These are in their order in agnst, so that the curves get the
+        // same ids as if we'd tried every pair.
+        near.Clear();
+        if(bvh) bvh->SurfacesInBox(amax, amin, &near);
+
+        int i;
+        for(i = 0; i < near.n; i++) {
+            SSurface *sb = &(agnst->surface.elem[near.elem[i].i]);
+            // Intersect this surface from our shell against the surface
             // from agnst; this will add zero or more curves to the curve
             // list for into.
             sa->IntersectAgainst(sb, this, agnst, into);
         }
     }
+    near.Clear();
+
+    into->exactCurves = NULL;
+    exact.Clear();
 }
 
 void SShell::CleanupAfterBoolean(void) {
     SSurface *ss;
     for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
         ss->edges.Clear();
+        // On the temporary heap, like the bvh.
+        ss->samples = NULL;
     }
+    // That was on the temporary heap.
+    bvh = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -781,6 +852,7 @@ void SShell::MakeClassifyingBsps(SShell *useCurvesFrom) {
     for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
         ss->MakeClassifyingBsp(this, useCurvesFrom);
     }
+    bvh = SBvh::From(this);
 }
 
 void SSurface::MakeClassifyingBsp(SShell *shell, SShell *useCurvesFrom) {
@@ -793,6 +865,8 @@ void SSurface::MakeClassifyingBsp(SShell *shell, SShell *useCurvesFrom) {
 
     ZERO(&edges);
     MakeEdgesInto(shell, &edges, AS_XYZ, useCurvesFrom);
+
+    samples = SSurfaceSamples::From(this);
 }
 
 SBspUv *SBspUv::Alloc(void) {
@@ -979,3 +1053,153 @@ double SBspUv::MinimumDistanceToEdge(Point2d p, SSurface *srf) {
     return min(d, min(dn, dp));
 }
 
+//-----------------------------------------------------------------------------
+// A bounding volume hierarchy over the surfaces of a shell. We split the
+// surfaces in half by the centers of their boxes, along whichever axis those
+// centers spread out the most, so each node's box is the union of its
+// children's.
+//-----------------------------------------------------------------------------
+SBvh *SBvh::Alloc(void) {
+    return (SBvh *)AllocTemporary(sizeof(SBvh));
+}
+
+static int SortAxis;
+static int ByCenter(const void *av, const void *bv)
+{
+    SBvh *a = *((SBvh **)av),
+         *b = *((SBvh **)bv);
+
+    double ca = (a->max).Plus(a->min).Element(SortAxis),
+           cb = (b->max).Plus(b->min).Element(SortAxis);
+    if(ca != cb) return (ca < cb) ? -1 : 1;
+    // Tie-break on the index, for the same tree whatever the qsort.
+    return (a->i < b->i) ? -1 : ((a->i > b->i) ? 1 : 0);
+}
+
+SBvh *SBvh::From(SShell *shell) {
+    int n = shell->surface.n;
+    if(n == 0) return NULL;
+
+    SBvh **leaf = (SBvh **)AllocTemporary(n*sizeof(SBvh *));
+    int i;
+    for(i = 0; i < n; i++) {
+        SBvh *b = Alloc();
+        b->srf = &(shell->surface.elem[i]);
+        b->i = i;
+        b->srf->GetAxisAlignedBounding(&(b->max), &(b->min));
+        leaf[i] = b;
+    }
+    return FromLeaves(leaf, n);
+}
+
+SBvh *SBvh::FromLeaves(SBvh **leaf, int n) {
+    if(n == 1) return leaf[0];
+
+    SBvh *ret = Alloc();
+    ret->max = Vector::From(VERY_NEGATIVE, VERY_NEGATIVE, VERY_NEGATIVE);
+    ret->min = Vector::From(VERY_POSITIVE, VERY_POSITIVE, VERY_POSITIVE);
+    Vector cmax = ret->max, cmin = ret->min;
+    int i;
+    for(i = 0; i < n; i++) {
+        (leaf[i]->max).MakeMaxMin(&(ret->max), &(ret->min));
+        (leaf[i]->min).MakeMaxMin(&(ret->max), &(ret->min));
+        (leaf[i]->max).Plus(leaf[i]->min).MakeMaxMin(&cmax, &cmin);
+    }
+
+    Vector d = cmax.Minus(cmin);
+    SortAxis = 0;
+    if(d.y > d.Element(SortAxis)) SortAxis = 1;
+    if(d.z > d.Element(SortAxis)) SortAxis = 2;
+    qsort(leaf, n, sizeof(leaf[0]), ByCenter);
+
+    ret->less = FromLeaves(leaf, n/2);
+    ret->more = FromLeaves(leaf + n/2, n - n/2);
+    return ret;
+}
+
+static int ByIndex(const void *av, const void *bv)
+{
+    int a = ((SIndex *)av)->i,
+        b = ((SIndex *)bv)->i;
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+//-----------------------------------------------------------------------------
+// Add the index of each surface whose box isn't disjoint from the given box,
+// with the same tolerance as Vector::BoundingBoxesDisjoint.
+//-----------------------------------------------------------------------------
+void SBvh::SurfacesInBox(Vector bmax, Vector bmin, List<SIndex> *l) {
+    BoxWorker(bmax, bmin, l);
+    qsort(l->elem, l->n, sizeof(l->elem[0]), ByIndex);
+}
+
+void SBvh::BoxWorker(Vector bmax, Vector bmin, List<SIndex> *l) {
+    if(Vector::BoundingBoxesDisjoint(max, min, bmax, bmin)) return;
+
+    if(srf) {
+        SIndex si = { i };
+        l->Add(&si);
+    } else {
+        less->BoxWorker(bmax, bmin, l);
+        more->BoxWorker(bmax, bmin, l);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Add the index of each surface that the line through a and b (or just the
+// segment, if seg is true) might intersect; that's a superset of the ones
+// that SSurface::LineEntirelyOutsideBbox() doesn't reject. Its tolerances
+// aren't quite those of a box grown by LENGTH_EPS, so we grow the boxes and
+// the segment by a bit more, and test them exactly.
+//-----------------------------------------------------------------------------
+void SBvh::SurfacesNearLine(Vector a, Vector b, bool seg, List<SIndex> *l) {
+    Vector dp = b.Minus(a);
+    double lp = dp.Magnitude();
+    double t0, t1;
+    if(lp == 0) {
+        // No direction, so no test; that's every surface.
+        Vector vp = Vector::From(VERY_POSITIVE, VERY_POSITIVE, VERY_POSITIVE),
+               vn = Vector::From(VERY_NEGATIVE, VERY_NEGATIVE, VERY_NEGATIVE);
+        BoxWorker(vp, vn, l);
+        qsort(l->elem, l->n, sizeof(l->elem[0]), ByIndex);
+        return;
+    } else if(seg) {
+        t0 = -10*LENGTH_EPS/lp;
+        t1 = 1 + 10*LENGTH_EPS/lp;
+    } else {
+        t0 = VERY_NEGATIVE;
+        t1 = VERY_POSITIVE;
+    }
+    LineWorker(a, dp, t0, t1, l);
+    qsort(l->elem, l->n, sizeof(l->elem[0]), ByIndex);
+}
+
+void SBvh::LineWorker(Vector p0, Vector dp, double t0, double t1,
+                      List<SIndex> *l)
+{
+    // Clip the parameter range t, where the line is p0 + t*dp, against each
+    // slab of the (grown) box in turn; if nothing's left, then we miss.
+    double tol = 10*LENGTH_EPS;
+    int k;
+    for(k = 0; k < 3; k++) {
+        double p = p0.Element(k), d = dp.Element(k),
+               lo = min.Element(k) - tol, hi = max.Element(k) + tol;
+        if(d == 0) {
+            if(p < lo || p > hi) return;
+            continue;
+        }
+        double ta = (lo - p)/d, tb = (hi - p)/d;
+        if(ta > tb) SWAP(double, ta, tb);
+        t0 = max(t0, ta);
+        t1 = min(t1, tb);
+        if(t0 > t1) return;
+    }
+
+    if(srf) {
+        SIndex si = { i };
+        l->Add(&si);
+    } else {
+        less->LineWorker(p0, dp, t0, t1, l);
+        more->LineWorker(p0, dp, t0, t1, l);
+    }
+}
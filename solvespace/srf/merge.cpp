@@ -6,12 +6,149 @@
 //-----------------------------------------------------------------------------
 #include "../solvespace.h"
 
+//-----------------------------------------------------------------------------
+// Coincident planes have almost the same normal and offset, so we hash each
+// plane by its color and by those, rounded to a grid, to find the candidates
+// for merging without trying every pair.
+//-----------------------------------------------------------------------------
+#define MERGE_CELL_N (1e-3)
+#define MERGE_CELL_D (1e-2)
+
+static void PlaneOf(SSurface *s, Vector *n, double *d) {
+    // Same as in SSurface::CoincidentWith()
+    *n = s->NormalAt(0, 0).WithMagnitude(1);
+    *d = n->Dot(s->ctrl[0][0]);
+}
+
+static SQWORD CellOf(double v, double cell) {
+    return (SQWORD)floor(v/cell + 0.5);
+}
+
+static DWORD HashPlane(int color, SQWORD nx, SQWORD ny, SQWORD nz, SQWORD d) {
+    return ((DWORD)color*2654435761u) ^ ((DWORD)nx*73856093) ^
+           ((DWORD)ny*19349663) ^ ((DWORD)nz*83492791) ^ ((DWORD)d*1000003);
+}
+
+//-----------------------------------------------------------------------------
+// Find the surfaces after si that might be coincident with it, same normal
+// and same color, in increasing order of index. A surface is coincident if
+// the corners of si lie within LENGTH_EPS of its plane; that bounds the
+// difference between the two normals and offsets, so we look in every cell
+// within that bound. If si is so small that the bound is loose, then that's
+// every surface after si.
+//-----------------------------------------------------------------------------
+static int ByIndex(const void *av, const void *bv)
+{
+    int a = ((SIndex *)av)->i,
+        b = ((SIndex *)bv)->i;
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+void SShell::FindMergeCandidates(int i, int *head, int *next, int tableSize,
+                                 List<SIndex> *l)
+{
+    SSurface *si = &(surface.elem[i]);
+    int j;
+
+    Vector tu = (si->ctrl[1][0]).Minus(si->ctrl[0][0]),
+           tv = (si->ctrl[0][1]).Minus(si->ctrl[0][0]);
+    double area = (tu.Cross(tv)).Magnitude();
+    // The sine of the angle between the normals is at most this.
+    double tn = 4*LENGTH_EPS*(tu.Magnitude() + tv.Magnitude());
+    if(tn >= area*MERGE_CELL_N) {
+        for(j = i + 1; j < surface.n; j++) {
+            SIndex sj = { j };
+            l->Add(&sj);
+        }
+        return;
+    }
+    tn /= area;
+    double td = tn*(si->ctrl[0][0]).Magnitude() + 2*LENGTH_EPS;
+
+    Vector n;
+    double d;
+    PlaneOf(si, &n, &d);
+    SQWORD c0[4], c1[4], c[4];
+    int k;
+    for(k = 0; k < 4; k++) {
+        double v   = (k < 3) ? n.Element(k) : d,
+               tol = (k < 3) ? tn : td,
+               cell = (k < 3) ? MERGE_CELL_N : MERGE_CELL_D;
+        c0[k] = CellOf(v - tol, cell);
+        c1[k] = CellOf(v + tol, cell);
+    }
+    for(c[0] = c0[0]; c[0] <= c1[0]; c[0]++) {
+        for(c[1] = c0[1]; c[1] <= c1[1]; c[1]++) {
+            for(c[2] = c0[2]; c[2] <= c1[2]; c[2]++) {
+                for(c[3] = c0[3]; c[3] <= c1[3]; c[3]++) {
+                    DWORD h = HashPlane(si->color, c[0], c[1], c[2], c[3]);
+                    for(j = head[h & (tableSize - 1)]; j; j = next[j - 1]) {
+                        if(j - 1 <= i) continue;
+                        SIndex sj = { j };
+                        l->Add(&sj);
+                    }
+                }
+            }
+        }
+    }
+
+    // These are plus one, and there's a duplicate if two cells hashed to
+    // the same bucket.
+    qsort(l->elem, l->n, sizeof(l->elem[0]), ByIndex);
+    int out = 0;
+    for(k = 0; k < l->n; k++) {
+        if(out > 0 && l->elem[out - 1].i == l->elem[k].i - 1) continue;
+        l->elem[out++].i = l->elem[k].i - 1;
+    }
+    l->n = out;
+}
+
+static void EdgeBox(SEdgeList *sel, Vector *maxv, Vector *minv) {
+    *maxv = Vector::From(VERY_NEGATIVE, VERY_NEGATIVE, VERY_NEGATIVE);
+    *minv = Vector::From(VERY_POSITIVE, VERY_POSITIVE, VERY_POSITIVE);
+    SEdge *se;
+    for(se = sel->l.First(); se; se = sel->l.NextAfter(se)) {
+        (se->a).MakeMaxMin(maxv, minv);
+        (se->b).MakeMaxMin(maxv, minv);
+    }
+}
+
 void SShell::MergeCoincidentSurfaces(void) {
     surface.ClearTags();
 
-    int i, j;
+    int i, j, k;
     SSurface *si, *sj;
 
+    int tableSize = 256;
+    while(tableSize < 2*surface.n) tableSize *= 2;
+    // The first surface in each bucket, and the next in the same bucket, as
+    // the index plus one; so zero for none.
+    int *head = (int *)MemAlloc(tableSize*sizeof(int));
+    int *next = (int *)MemAlloc((surface.n + 1)*sizeof(int));
+    for(i = 0; i < surface.n; i++) {
+        si = &(surface.elem[i]);
+        if(si->trim.n == 0) continue;
+        if(si->degm != 1 || si->degn != 1) continue;
+
+        Vector n;
+        double d;
+        PlaneOf(si, &n, &d);
+        DWORD h = HashPlane(si->color, CellOf(n.x, MERGE_CELL_N),
+                                       CellOf(n.y, MERGE_CELL_N),
+                                       CellOf(n.z, MERGE_CELL_N),
+                                       CellOf(d,   MERGE_CELL_D));
+        next[i] = head[h & (tableSize - 1)];
+        head[h & (tableSize - 1)] = i + 1;
+    }
+    // The bounding box of each surface's trim edges, when we first need it;
+    // and what each surface got merged in to, plus one.
+    Vector *emax = (Vector *)MemAlloc((surface.n + 1)*sizeof(Vector)),
+           *emin = (Vector *)MemAlloc((surface.n + 1)*sizeof(Vector));
+    bool *haveBox = (bool *)MemAlloc((surface.n + 1)*sizeof(bool));
+    int *mergedInto = (int *)MemAlloc((surface.n + 1)*sizeof(int));
+
+    List<SIndex> cand;
+    ZERO(&cand);
+
     for(i = 0; i < surface.n; i++) {
         si = &(surface.elem[i]);
         if(si->tag) continue;
@@ -22,15 +159,22 @@ void SShell::MergeCoincidentSurfaces(void) {
         // time on other surfaces.
         if(si->degm != 1 || si->degn != 1) continue;
 
+        cand.Clear();
+        FindMergeCandidates(i, head, next, tableSize, &cand);
+        if(cand.n == 0) continue;
+
         SEdgeList sel;
         ZERO(&sel);
         si->MakeEdgesInto(this, &sel, SSurface::AS_XYZ);
+        Vector smax, smin;
+        EdgeBox(&sel, &smax, &smin);
 
         bool mergedThisTime, merged = false;
         do {
             mergedThisTime = false;
 
-            for(j = i + 1; j < surface.n; j++) {
+            for(k = 0; k < cand.n; k++) {
+                j = cand.elem[k].i;
                 sj = &(surface.elem[j]);
                 if(sj->tag) continue;
                 if(!sj->CoincidentWith(si, true)) continue;
@@ -41,10 +185,24 @@ void SShell::MergeCoincidentSurfaces(void) {
                 // This surface is coincident. But let's not merge coincident
                 // surfaces if they contain disjoint contours; that just makes
                 // the bounding box tests less effective, and possibly things
-                // less robust.
+                // less robust. They can't share an edge unless their boxes
+                // touch, which is a quicker test.
                 SEdgeList tel;
                 ZERO(&tel);
-                sj->MakeEdgesInto(this, &tel, SSurface::AS_XYZ);
+                if(!haveBox[j]) {
+                    sj->MakeEdgesInto(this, &tel, SSurface::AS_XYZ);
+                    EdgeBox(&tel, &(emax[j]), &(emin[j]));
+                    haveBox[j] = true;
+                }
+                if(Vector::BoundingBoxesDisjoint(smax, smin,
+                                                 emax[j], emin[j]))
+                {
+                    tel.Clear();
+                    continue;
+                }
+                if(tel.l.n == 0) {
+                    sj->MakeEdgesInto(this, &tel, SSurface::AS_XYZ);
+                }
                 if(!sel.ContainsEdgeFrom(&tel)) {
                     tel.Clear();
                     continue;
@@ -56,14 +214,9 @@ void SShell::MergeCoincidentSurfaces(void) {
                 mergedThisTime = true;
                 sj->MakeEdgesInto(this, &sel, SSurface::AS_XYZ);
                 sj->trim.Clear();
-
-                // All the references to this surface get replaced with the
-                // new srf
-                SCurve *sc;
-                for(sc = curve.First(); sc; sc = curve.NextAfter(sc)) {
-                    if(sc->surfA.v == sj->h.v) sc->surfA = si->h;
-                    if(sc->surfB.v == sj->h.v) sc->surfB = si->h;
-                }
+                (emax[j]).MakeMaxMin(&smax, &smin);
+                (emin[j]).MakeMaxMin(&smax, &smin);
+                mergedInto[j] = i + 1;
             }
 
             // If this iteration merged a contour onto ours, then we have to
@@ -123,6 +276,27 @@ void SShell::MergeCoincidentSurfaces(void) {
         }
         sel.Clear();
     }
+    cand.Clear();
+
+    // All the references to the merged surfaces get replaced with the
+    // surfaces that they were merged in to.
+    SCurve *sc;
+    for(sc = curve.First(); sc; sc = curve.NextAfter(sc)) {
+        for(k = 0; k < 2; k++) {
+            hSSurface *hs = (k == 0) ? &(sc->surfA) : &(sc->surfB);
+            SSurface *ss = surface.FindByIdNoOops(*hs);
+            if(!ss) continue;
+            int into = mergedInto[ss - surface.elem];
+            if(into) *hs = surface.elem[into - 1].h;
+        }
+    }
+
+    MemFree(head);
+    MemFree(next);
+    MemFree(emax);
+    MemFree(emin);
+    MemFree(haveBox);
+    MemFree(mergedInto);
 
     surface.RemoveTagged();
 }
@@ -95,6 +95,57 @@ double BernsteinDerivative(int k, int deg, double t)
     oops();
 }
 
+//-----------------------------------------------------------------------------
+// All of the Bernstein polynomials of degree deg at t, in B[0...deg], and
+// their derivatives in Bp[] unless that's NULL. That's cheaper than asking
+// for them one at a time, when we'll need all of them anyways.
+//-----------------------------------------------------------------------------
+static void BernsteinBasis(int deg, double t, double *B, double *Bp)
+{
+    double s = 1 - t;
+    switch(deg) {
+        case 0:
+            B[0] = 1;
+            if(Bp) Bp[0] = 0;
+            break;
+
+        case 1:
+            B[0] = s;
+            B[1] = t;
+            if(Bp) {
+                Bp[0] = -1;
+                Bp[1] = 1;
+            }
+            break;
+
+        case 2:
+            B[0] = s*s;
+            B[1] = 2*s*t;
+            B[2] = t*t;
+            if(Bp) {
+                Bp[0] = -2 + 2*t;
+                Bp[1] = 2 - 4*t;
+                Bp[2] = 2*t;
+            }
+            break;
+
+        case 3:
+            B[0] = s*s*s;
+            B[1] = 3*s*s*t;
+            B[2] = 3*s*t*t;
+            B[3] = t*t*t;
+            if(Bp) {
+                Bp[0] = -3 + 6*t - 3*t*t;
+                Bp[1] = 3 - 12*t + 9*t*t;
+                Bp[2] = 6*t - 9*t*t;
+                Bp[3] = 3*t*t;
+            }
+            break;
+
+        default: oops();
+    }
+}
+
 Vector SBezier::PointAt(double t) {
     Vector pt = Vector::From(0, 0, 0);
     double d = 0;
@@ -309,55 +360,94 @@ Vector SSurface::PointAt(Point2d puv) {
     return PointAt(puv.x, puv.y);
 }
 Vector SSurface::PointAt(double u, double v) {
-    Vector num = Vector::From(0, 0, 0);
-    double den = 0;
+    double Bu[4], Bv[4];
+    BernsteinBasis(degm, u, Bu, NULL);
+    BernsteinBasis(degn, v, Bv, NULL);
 
-    int i, j;
-    for(i = 0; i <= degm; i++) {
-        for(j = 0; j <= degn; j++) {
-            double Bi = Bernstein(i, degm, u),
-                   Bj = Bernstein(j, degn, v);
-
-            num = num.Plus(ctrl[i][j].ScaledBy(Bi*Bj*weight[i][j]));
-            den += weight[i][j]*Bi*Bj;
-        }
-    }
-    num = num.ScaledBy(1.0/den);
-    return num;
+    Vector pt;
+    EvalWithBasis(Bu, NULL, Bv, NULL, &pt, NULL, NULL);
+    return pt;
 }
 
 void SSurface::TangentsAt(double u, double v, Vector *tu, Vector *tv) {
-    Vector num   = Vector::From(0, 0, 0),
-           num_u = Vector::From(0, 0, 0),
-           num_v = Vector::From(0, 0, 0);
-    double den   = 0,
-           den_u = 0,
-           den_v = 0;
+    double Bu[4], Bv[4], Bup[4], Bvp[4];
+    BernsteinBasis(degm, u, Bu, Bup);
+    BernsteinBasis(degn, v, Bv, Bvp);
+
+    EvalWithBasis(Bu, Bup, Bv, Bvp, NULL, tu, tv);
+}
+
+//-----------------------------------------------------------------------------
+// Evaluate the surface given the basis functions in u and v (and their
+// derivatives, if we want the tangents); any of pt, tu, and tv may be NULL.
+// The sums are written out in scalars, since that's a lot quicker than
+// building them up as Vectors.
+//-----------------------------------------------------------------------------
+void SSurface::EvalWithBasis(double *Bu, double *Bup, double *Bv, double *Bvp,
+                             Vector *pt, Vector *tu, Vector *tv)
+{
+    double nx = 0, ny = 0, nz = 0, den = 0,
+           nux = 0, nuy = 0, nuz = 0, den_u = 0,
+           nvx = 0, nvy = 0, nvz = 0, den_v = 0;
+    bool tangents = (tu || tv);
 
     int i, j;
     for(i = 0; i <= degm; i++) {
         for(j = 0; j <= degn; j++) {
-            double Bi  = Bernstein(i, degm, u),
-                   Bj  = Bernstein(j, degn, v),
-                   Bip = BernsteinDerivative(i, degm, u),
-                   Bjp = BernsteinDerivative(j, degn, v);
+            Vector *c = &(ctrl[i][j]);
+            double w = weight[i][j], s;
+
+            s = Bu[i]*Bv[j]*w;
+            nx += c->x*s; ny += c->y*s; nz += c->z*s;
+            den += w*Bu[i]*Bv[j];
 
-            num = num.Plus(ctrl[i][j].ScaledBy(Bi*Bj*weight[i][j]));
-            den += weight[i][j]*Bi*Bj;
+            if(!tangents) continue;
 
-            num_u = num_u.Plus(ctrl[i][j].ScaledBy(Bip*Bj*weight[i][j]));
-            den_u += weight[i][j]*Bip*Bj;
+            s = Bup[i]*Bv[j]*w;
+            nux += c->x*s; nuy += c->y*s; nuz += c->z*s;
+            den_u += w*Bup[i]*Bv[j];
 
-            num_v = num_v.Plus(ctrl[i][j].ScaledBy(Bi*Bjp*weight[i][j]));
-            den_v += weight[i][j]*Bi*Bjp;
+            s = Bu[i]*Bvp[j]*w;
+            nvx += c->x*s; nvy += c->y*s; nvz += c->z*s;
+            den_v += w*Bu[i]*Bvp[j];
         }
     }
+    Vector num = Vector::From(nx, ny, nz);
+    if(pt) *pt = num.ScaledBy(1.0/den);
+    if(!tangents) return;
+
     // quotient rule; f(t) = n(t)/d(t), so f' = (n'*d - n*d')/(d^2)
-    *tu = ((num_u.ScaledBy(den)).Minus(num.ScaledBy(den_u)));
-    *tu = tu->ScaledBy(1.0/(den*den));
+    Vector num_u = Vector::From(nux, nuy, nuz),
+           num_v = Vector::From(nvx, nvy, nvz);
+    if(tu) {
+        *tu = ((num_u.ScaledBy(den)).Minus(num.ScaledBy(den_u)));
+        *tu = tu->ScaledBy(1.0/(den*den));
+    }
+    if(tv) {
+        *tv = ((num_v.ScaledBy(den)).Minus(num.ScaledBy(den_v)));
+        *tv = tv->ScaledBy(1.0/(den*den));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// The points and normals at n positions in uv, as for PointAt and NormalAt
+// but all at once. Positions with the same u, like the columns of a grid
+// when sorted, share the basis functions in u instead of repeating them.
+//-----------------------------------------------------------------------------
+void SSurface::PointsAndNormalsAt(int n, Point2d *puv, Vector *pt, Vector *nv)
+{
+    double Bu[4], Bup[4], Bv[4], Bvp[4];
+    int k;
+    for(k = 0; k < n; k++) {
+        if(k == 0 || puv[k].x != puv[k-1].x) {
+            BernsteinBasis(degm, puv[k].x, Bu, Bup);
+        }
+        BernsteinBasis(degn, puv[k].y, Bv, Bvp);
 
-    *tv = ((num_v.ScaledBy(den)).Minus(num.ScaledBy(den_v)));
-    *tv = tv->ScaledBy(1.0/(den*den));
+        Vector tu, tv;
+        EvalWithBasis(Bu, Bup, Bv, Bvp, &(pt[k]), &tu, &tv);
+        nv[k] = tu.Cross(tv);
+    }
 }
 
 Vector SSurface::NormalAt(Point2d puv) {
@@ -409,19 +499,23 @@ void SSurface::ClosestPointTo(Vector p, double *u, double *v, bool converge) {
     }
 
     // Search for a reasonable initial guess
-    int i, j;
-    double minDist = VERY_POSITIVE;
-    int res = (max(degm, degn) == 2) ? 7 : 20;
-    for(i = 0; i < res; i++) {
-        for(j = 0; j < res; j++) {
-            double tryu = (i + 0.5)/res, tryv = (j + 0.5)/res;
-           
-            Vector tryp = PointAt(tryu, tryv);
-            double d = (tryp.Minus(p)).Magnitude();
-            if(d < minDist) {
-                *u = tryu;
-                *v = tryv;
-                minDist = d;
+    if(samples) {
+        samples->NearestTo(p, u, v);
+    } else {
+        int i, j;
+        double minDist = VERY_POSITIVE;
+        int res = SSurfaceSamples::ResFor(this);
+        for(i = 0; i < res; i++) {
+            for(j = 0; j < res; j++) {
+                double tryu = (i + 0.5)/res, tryv = (j + 0.5)/res;
+
+                Vector tryp = PointAt(tryu, tryv);
+                double d = (tryp.Minus(p)).Magnitude();
+                if(d < minDist) {
+                    *u = tryu;
+                    *v = tryv;
+                    minDist = d;
+                }
             }
         }
     }
@@ -438,6 +532,90 @@ void SSurface::ClosestPointTo(Vector p, double *u, double *v, bool converge) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// The grid of points from which ClosestPointTo picks its first guess. That's
+// the same grid whether or not we've got these samples, and we pick the same
+// point from it; but with the samples, the surface is evaluated just once at
+// each point of the grid, and most of the points don't get tested.
+//-----------------------------------------------------------------------------
+int SSurfaceSamples::ResFor(SSurface *srf) {
+    return (max(srf->degm, srf->degn) == 2) ? 7 : 20;
+}
+
+SSurfaceSamples *SSurfaceSamples::From(SSurface *srf) {
+    // Planes get projected without any first guess.
+    if(srf->degm == 1 && srf->degn == 1) return NULL;
+
+    SSurfaceSamples *ret =
+        (SSurfaceSamples *)AllocTemporary(sizeof(SSurfaceSamples));
+    ret->res = ResFor(srf);
+    ret->blocks = (ret->res + BLOCK - 1)/BLOCK;
+
+    int i, j;
+    for(i = 0; i < ret->res; i++) {
+        for(j = 0; j < ret->res; j++) {
+            Vector p = srf->PointAt((i + 0.5)/ret->res, (j + 0.5)/ret->res);
+            ret->pt[i][j] = p;
+
+            Vector *bmax = &(ret->bmax[i/BLOCK][j/BLOCK]),
+                   *bmin = &(ret->bmin[i/BLOCK][j/BLOCK]);
+            if(i % BLOCK == 0 && j % BLOCK == 0) {
+                *bmax = p;
+                *bmin = p;
+            } else {
+                p.MakeMaxMin(bmax, bmin);
+            }
+        }
+    }
+    return ret;
+}
+
+void SSurfaceSamples::NearestTo(Vector p, double *u, double *v) {
+    // A lower bound on the distance to any point in each block, from its
+    // bounding box; then visit the blocks nearest first, so that we can
+    // stop once the rest are farther away than the best point so far.
+    double lb[MAX_BLOCKS*MAX_BLOCKS];
+    int order[MAX_BLOCKS*MAX_BLOCKS];
+    int n = blocks*blocks, k, m;
+    for(k = 0; k < n; k++) {
+        Vector *bmx = &(bmax[k/blocks][k%blocks]),
+               *bmn = &(bmin[k/blocks][k%blocks]);
+        double dx = max(0, max(bmn->x - p.x, p.x - bmx->x)),
+               dy = max(0, max(bmn->y - p.y, p.y - bmx->y)),
+               dz = max(0, max(bmn->z - p.z, p.z - bmx->z));
+        lb[k] = sqrt(dx*dx + dy*dy + dz*dz);
+
+        for(m = k; m > 0 && lb[order[m-1]] > lb[k]; m--) {
+            order[m] = order[m-1];
+        }
+        order[m] = k;
+    }
+
+    // Ties go to the point that comes first in the grid, u then v.
+    double minDist = VERY_POSITIVE;
+    int best = -1;
+    for(m = 0; m < n; m++) {
+        k = order[m];
+        if(lb[k] > minDist) break;
+
+        int bi = k/blocks, bj = k%blocks, i, j;
+        for(i = bi*BLOCK; i < min(res, (bi + 1)*BLOCK); i++) {
+            for(j = bj*BLOCK; j < min(res, (bj + 1)*BLOCK); j++) {
+                double d = (pt[i][j].Minus(p)).Magnitude();
+                int at = i*res + j;
+                if(d < minDist || (d == minDist && at < best)) {
+                    minDist = d;
+                    best = at;
+                }
+            }
+        }
+    }
+    if(best < 0) return;
+
+    *u = (best/res + 0.5)/res;
+    *v = (best%res + 0.5)/res;
+}
+
 bool SSurface::ClosestPointNewton(Vector p, double *u, double *v, bool converge)
 {
     // Initial guess is in u, v; refine by Newton iteration.
@@ -384,10 +384,24 @@ void SShell::AllPointsIntersecting(Vector a, Vector b,
                                    List<SInter> *il,
                                    bool seg, bool trimmed, bool inclTangent)
 {
-    SSurface *ss;
-    for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
+    if(!bvh) {
+        SSurface *ss;
+        for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
+            ss->AllPointsIntersecting(a, b, il, seg, trimmed, inclTangent);
+        }
+        return;
+    }
+
+    // During a Boolean, we can skip most of the surfaces quickly.
+    List<SIndex> near;
+    ZERO(&near);
+    bvh->SurfacesNearLine(a, b, seg, &near);
+    int i;
+    for(i = 0; i < near.n; i++) {
+        SSurface *ss = &(surface.elem[near.elem[i].i]);
         ss->AllPointsIntersecting(a, b, il, seg, trimmed, inclTangent);
     }
+    near.Clear();
 }
 
 
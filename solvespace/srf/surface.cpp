@@ -402,6 +402,22 @@ void SSurface::MakeSectionEdgesInto(SShell *shell,
     }
 }
 
+//-----------------------------------------------------------------------------
+// A vertex of the triangulation, with its position in uv, and where to write
+// the corresponding point and normal in xyz.
+//-----------------------------------------------------------------------------
+typedef struct {
+    double   u, v;
+    Vector  *p, *n;
+} TriVertex;
+static int ByUv(const void *av, const void *bv) {
+    const TriVertex *a = (const TriVertex *)av,
+                    *b = (const TriVertex *)bv;
+    if(a->u != b->u) return (a->u < b->u) ? -1 : 1;
+    if(a->v != b->v) return (a->v < b->v) ? -1 : 1;
+    return 0;
+}
+
 void SSurface::TriangulateInto(SShell *shell, SMesh *sm) {
     SEdgeList el;
     ZERO(&el);
@@ -428,16 +444,50 @@ void SSurface::TriangulateInto(SShell *shell, SMesh *sm) {
             poly.UvGridTriangulateInto(sm, this);
         }
 
+        // Most vertices are shared by several triangles, so sort them by
+        // position in uv, and evaluate the surface once for each, all in
+        // one batch.
+        int k, nv = 3*(sm->l.n - start);
+        TriVertex *tv = (TriVertex *)MemAlloc((nv + 1)*sizeof(TriVertex));
+        for(i = start, k = 0; i < sm->l.n; i++) {
+            STriangle *st = &(sm->l.elem[i]);
+            Vector *p[3] = { &(st->a),  &(st->b),  &(st->c)  },
+                   *n[3] = { &(st->an), &(st->bn), &(st->cn) };
+            int j;
+            for(j = 0; j < 3; j++, k++) {
+                tv[k].u = p[j]->x;
+                tv[k].v = p[j]->y;
+                tv[k].p = p[j];
+                tv[k].n = n[j];
+            }
+        }
+        qsort(tv, nv, sizeof(tv[0]), ByUv);
+        Point2d *puv = (Point2d *)MemAlloc((nv + 1)*sizeof(Point2d));
+        Vector *pt = (Vector *)MemAlloc((nv + 1)*sizeof(Vector)),
+               *nt = (Vector *)MemAlloc((nv + 1)*sizeof(Vector));
+        int n = 0;
+        for(k = 0; k < nv; k++) {
+            if(k == 0 || ByUv(&(tv[k]), &(tv[k-1])) != 0) {
+                puv[n].x = tv[k].u;
+                puv[n].y = tv[k].v;
+                n++;
+            }
+        }
+        PointsAndNormalsAt(n, puv, pt, nt);
+        for(k = 0, n = -1; k < nv; k++) {
+            if(k == 0 || ByUv(&(tv[k]), &(tv[k-1])) != 0) n++;
+            *(tv[k].p) = pt[n];
+            *(tv[k].n) = nt[n];
+        }
+        MemFree(tv);
+        MemFree(puv);
+        MemFree(pt);
+        MemFree(nt);
+
         STriMeta meta = { face, color };
         for(i = start; i < sm->l.n; i++) {
             STriangle *st = &(sm->l.elem[i]);
             st->meta = meta;
-            st->an = NormalAt(st->a.x, st->a.y);
-            st->bn = NormalAt(st->b.x, st->b.y);
-            st->cn = NormalAt(st->c.x, st->c.y);
-            st->a = PointAt(st->a.x, st->a.y);
-            st->b = PointAt(st->b.x, st->b.y);
-            st->c = PointAt(st->c.x, st->c.y);
             // Works out that my chosen contour direction is inconsistent with
             // the triangle direction, sigh.
             st->FlipNormal();
@@ -54,6 +54,42 @@ public:
 
 class SShell;
 
+// An index into a list, like that of the surfaces in a shell. This isn't
+// just an int because List<T> finds MemRealloc() and MemFree() by
+// argument-dependent lookup, and there's none for a builtin type.
+class SIndex {
+public:
+    int     i;
+};
+
+// A bounding volume hierarchy over the surfaces of a shell, so that we can
+// find the surfaces that might touch a given box or line without testing
+// them all.
+class SBvh {
+public:
+    Vector  max, min;
+
+    // For a leaf, the surface, and its index in the shell's list; else the
+    // two halves.
+    SSurface *srf;
+    int      i;
+    SBvh    *less;
+    SBvh    *more;
+
+    static SBvh *Alloc(void);
+    static SBvh *From(SShell *shell);
+    static SBvh *FromLeaves(SBvh **leaf, int n);
+
+    // The surfaces that might touch, by index in the shell, in increasing
+    // order; so in the same order as if we'd tested every one.
+    void SurfacesInBox(Vector bmax, Vector bmin, List<SIndex> *l);
+    void SurfacesNearLine(Vector a, Vector b, bool seg, List<SIndex> *l);
+
+    void BoxWorker(Vector bmax, Vector bmin, List<SIndex> *l);
+    void LineWorker(Vector p0, Vector dp, double t0, double t1,
+                    List<SIndex> *l);
+};
+
 class hSSurface {
 public:
     DWORD v;
@@ -208,6 +244,38 @@ public:
     void Clear(void);
 };
 
+// The exact curves in a shell, hashed by the cell of space that contains
+// their starting point, to quickly find any identical to a given curve.
+class SCurveIndex {
+public:
+    typedef struct {
+        hSCurve     curve;
+        Vector      start;
+        int         next;
+    } Entry;
+
+    List<Entry>     entry;
+    // The first entry in each bucket, plus one; so zero if it's empty
+    int            *head;
+    int             tableSize;
+
+    void Add(SCurve *sc);
+    SCurve *FindSameAs(SBezier *sb, SShell *shell, bool *backwards);
+    void Clear(void);
+
+    static DWORD HashCell(SQWORD x, SQWORD y, SQWORD z);
+    void Rehash(void);
+};
+
+// An intersection curve in the result of a Boolean, listed under the
+// surface that it trims, and with the surface from the other shell.
+typedef struct {
+    DWORD       srf;
+    DWORD       other;
+    int         curve;
+    SSurface   *ss;
+} SInterCurve;
+
 // A segment of a curve by which a surface is trimmed: indicates which curve,
 // by its handle, and the starting and ending points of our segment of it.
 // The vector out points out of the surface; it, the surface outer normal,
@@ -240,6 +308,26 @@ public:
     bool        onEdge;         // pinter is on edge of trim poly
 };
 
+// A grid of points on a surface, from which to pick the first guess when we
+// project a point into it. The points are grouped into square blocks, each
+// with its bounding box, so that we needn't test most of them.
+class SSurfaceSamples {
+public:
+    static const int MAX_RES    = 20;
+    static const int BLOCK      = 4;
+    static const int MAX_BLOCKS = (MAX_RES + BLOCK - 1)/BLOCK;
+
+    int         res;
+    int         blocks;
+    Vector      pt[MAX_RES][MAX_RES];
+    Vector      bmax[MAX_BLOCKS][MAX_BLOCKS];
+    Vector      bmin[MAX_BLOCKS][MAX_BLOCKS];
+
+    static int ResFor(SSurface *srf);
+    static SSurfaceSamples *From(SSurface *srf);
+    void NearestTo(Vector p, double *u, double *v);
+};
+
 // A rational polynomial surface in Bezier form.
 class SSurface {
 public:
@@ -262,6 +350,9 @@ public:
     // For testing whether a point (u, v) on the surface lies inside the trim
     SBspUv          *bsp;
     SEdgeList       edges;
+    // And for projecting points into the surface quickly; like the bsp,
+    // that's on the temporary heap, and only while we do a Boolean.
+    SSurfaceSamples *samples;
 
     // For caching our initial (u, v) when doing Newton iterations to project
     // a point into our surface.
@@ -283,7 +374,8 @@ public:
                                   SShell *shell, SShell *sha, SShell *shb);
     void FindChainAvoiding(SEdgeList *src, SEdgeList *dest, SPointList *avoid);
     SSurface MakeCopyTrimAgainst(SShell *parent, SShell *a, SShell *b,
-                                    SShell *into, int type);
+                                    SShell *into, int type,
+                                    SInterCurve *ic, int icn);
     void TrimFromEdgeList(SEdgeList *el, bool asUv);
     void IntersectAgainst(SSurface *b, SShell *agnstA, SShell *agnstB, 
                           SShell *into);
@@ -321,6 +413,9 @@ public:
     void TangentsAt(double u, double v, Vector *tu, Vector *tv);
     Vector NormalAt(Point2d puv);
     Vector NormalAt(double u, double v);
+    void EvalWithBasis(double *Bu, double *Bup, double *Bv, double *Bvp,
+                       Vector *pt, Vector *tu, Vector *tv);
+    void PointsAndNormalsAt(int n, Point2d *puv, Vector *pt, Vector *nv);
     bool LineEntirelyOutsideBbox(Vector a, Vector b, bool segment);
     void GetAxisAlignedBounding(Vector *ptMax, Vector *ptMin);
     bool CoincidentWithPlane(Vector n, double d);
@@ -358,6 +453,13 @@ public:
 
     bool                        booleanFailed;
 
+    // While we're making the intersection curves for a Boolean, the exact
+    // curves already in this shell.
+    SCurveIndex                *exactCurves;
+    // During a Boolean, a hierarchy of our surfaces' bounding boxes, for
+    // the ray and segment queries; NULL otherwise.
+    SBvh                       *bvh;
+
     void MakeFromExtrusionOf(SBezierLoopSet *sbls, Vector t0, Vector t1,
                              int color);
     void MakeFromRevolutionOf(SBezierLoopSet *sbls, Vector pt, Vector axis,
@@ -400,6 +502,8 @@ public:
                                     Vector trans, Quaternion q, double scale);
     void MakeFromAssemblyOf(SShell *a, SShell *b);
     void MergeCoincidentSurfaces(void);
+    void FindMergeCandidates(int i, int *head, int *next, int tableSize,
+                             List<SIndex> *l);
 
     void TriangulateInto(SMesh *sm);
     void MakeEdgesInto(SEdgeList *sel);
@@ -9,6 +9,113 @@
 
 extern int FLAG;
 
+//-----------------------------------------------------------------------------
+// An index of exact curves by their starting point. Two curves are the same
+// only if their starting points are within LENGTH_EPS, so we hash the cell
+// of a grid that contains each starting point, and then look in every cell
+// within LENGTH_EPS of the point that we're looking for.
+//-----------------------------------------------------------------------------
+#define CURVE_INDEX_CELL (0.01)
+
+DWORD SCurveIndex::HashCell(SQWORD x, SQWORD y, SQWORD z) {
+    return ((DWORD)x*73856093) ^ ((DWORD)y*19349663) ^ ((DWORD)z*83492791);
+}
+
+static SQWORD CellOf(double v) {
+    return (SQWORD)floor(v / CURVE_INDEX_CELL);
+}
+
+void SCurveIndex::Rehash(void) {
+    if(head) MemFree(head);
+    tableSize = max(256, tableSize*2);
+    head = (int *)MemAlloc(tableSize*sizeof(int));
+
+    int i;
+    for(i = 0; i < entry.n; i++) {
+        Entry *e = &(entry.elem[i]);
+        DWORD h = HashCell(CellOf(e->start.x), CellOf(e->start.y),
+                           CellOf(e->start.z));
+        int b = (int)(h & (tableSize - 1));
+        e->next = head[b];
+        head[b] = i + 1;
+    }
+}
+
+void SCurveIndex::Add(SCurve *sc) {
+    Entry e;
+    ZERO(&e);
+    e.curve = sc->h;
+    e.start = sc->exact.ctrl[0];
+    entry.Add(&e);
+
+    // Rehashing links in everything, including the new one.
+    if(entry.n*2 > tableSize) {
+        Rehash();
+        return;
+    }
+    Entry *en = &(entry.elem[entry.n - 1]);
+    DWORD h = HashCell(CellOf(e.start.x), CellOf(e.start.y),
+                       CellOf(e.start.z));
+    int b = (int)(h & (tableSize - 1));
+    en->next = head[b];
+    head[b] = entry.n;
+}
+
+//-----------------------------------------------------------------------------
+// Find the curve in the shell that's identical to sb, or to sb reversed (in
+// which case backwards is set true); or NULL if there's none. If there's more
+// than one, then the first in the shell, with the forwards test first, same
+// as a linear search.
+//-----------------------------------------------------------------------------
+SCurve *SCurveIndex::FindSameAs(SBezier *sb, SShell *shell, bool *backwards) {
+    if(!head) return NULL;
+
+    SBezier sbrev = *sb;
+    sbrev.Reverse();
+
+    SCurve *best = NULL;
+    int pass;
+    for(pass = 0; pass < 2; pass++) {
+        // A curve that's the same as sb starts where sb does; one that's
+        // the same as sb reversed starts where sb finishes.
+        Vector p = (pass == 0) ? sb->Start() : sb->Finish();
+        SQWORD x0 = CellOf(p.x - LENGTH_EPS), x1 = CellOf(p.x + LENGTH_EPS),
+               y0 = CellOf(p.y - LENGTH_EPS), y1 = CellOf(p.y + LENGTH_EPS),
+               z0 = CellOf(p.z - LENGTH_EPS), z1 = CellOf(p.z + LENGTH_EPS);
+        SQWORD x, y, z;
+        for(x = x0; x <= x1; x++) {
+            for(y = y0; y <= y1; y++) {
+                for(z = z0; z <= z1; z++) {
+                    DWORD h = HashCell(x, y, z);
+                    int i = head[h & (tableSize - 1)];
+                    for(; i; i = entry.elem[i - 1].next) {
+                        Entry *e = &(entry.elem[i - 1]);
+                        if(!(e->start).Equals(p)) continue;
+                        if(best && best->h.v <= e->curve.v) continue;
+
+                        SCurve *se = shell->curve.FindById(e->curve);
+                        if(sb->Equals(&(se->exact))) {
+                            best = se;
+                            *backwards = false;
+                        } else if(sbrev.Equals(&(se->exact))) {
+                            best = se;
+                            *backwards = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+void SCurveIndex::Clear(void) {
+    entry.Clear();
+    if(head) MemFree(head);
+    head = NULL;
+    tableSize = 0;
+}
+
 void SSurface::AddExactIntersectionCurve(SBezier *sb, SSurface *srfB,
                             SShell *agnstA, SShell *agnstB, SShell *into)
 {
@@ -24,23 +131,9 @@ void SSurface::AddExactIntersectionCurve(SBezier *sb, SSurface *srfB,
     // Now we have to piecewise linearize the curve. If there's already an
     // identical curve in the shell, then follow that pwl exactly, otherwise
     // calculate from scratch.
-    SCurve split, *existing = NULL, *se;
-    SBezier sbrev = *sb;
-    sbrev.Reverse();
+    SCurve split, *existing;
     bool backwards = false;
-    for(se = into->curve.First(); se; se = into->curve.NextAfter(se)) {
-        if(se->isExact) {
-            if(sb->Equals(&(se->exact))) {
-                existing = se;
-                break;
-            }
-            if(sbrev.Equals(&(se->exact))) {
-                existing = se;
-                backwards = true;
-                break;
-            }
-        }
-    }
+    existing = into->exactCurves->FindSameAs(sb, into, &backwards);
     if(existing) {
         SCurvePt *v;
         for(v = existing->pts.First(); v; v = existing->pts.NextAfter(v)) {
@@ -101,6 +194,7 @@ void SSurface::AddExactIntersectionCurve(SBezier *sb, SSurface *srfB,
 
     split.source = SCurve::FROM_INTERSECTION;
     into->curve.AddAndAssignId(&split);
+    into->exactCurves->Add(&split);
 }
 
 void SSurface::IntersectAgainst(SSurface *b, SShell *agnstA, SShell *agnstB, 
@@ -1,8 +1,9 @@
 //-----------------------------------------------------------------------------
 // Triangulate a surface. If the surface is curved, then we first superimpose
 // a grid of quads, with spacing to achieve our chord tolerance. We then
-// proceed by ear-clipping; the resulting mesh should be watertight and not
-// awful numerically, but has no special properties (Delaunay, etc.).
+// proceed by ear-clipping, or for a plane by decomposing in to monotone
+// pieces; the resulting mesh should be watertight and not awful numerically,
+// but has no special properties (Delaunay, etc.).
 //
 // Copyright 2008-2013 Jonathan Westhues.
 //-----------------------------------------------------------------------------
@@ -15,6 +16,13 @@ void SPolygon::UvTriangulateInto(SMesh *m, SSurface *srf) {
 
     normal = Vector::From(0, 0, 1);
 
+    if(srf->degm == 1 && srf->degn == 1) {
+        // This is a plane, so any triangulation is as good as any other, and
+        // the sweep is fastest. But if it fails, then clip ears.
+        FixContourDirections();
+        if(SweepTriangulateInto(m, srf)) return;
+    }
+
     while(l.n > 0) {
         FixContourDirections();
         l.ClearTags();
@@ -424,6 +432,24 @@ void SSurface::MakeTriangulationGridInto(List<double> *l, double vs, double vf,
     }
 }
 
+//-----------------------------------------------------------------------------
+// Find the cell of a grid, with lines at l, that contains x; a point that
+// lies on a line goes in the cell below it, and anything off the grid goes
+// in the nearest cell.
+//-----------------------------------------------------------------------------
+static int GridCellOf(List<double> *l, double x) {
+    int lo = 0, hi = l->n - 2;
+    while(lo < hi) {
+        int mid = (lo + hi + 1)/2;
+        if(l->elem[mid] < x) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
 void SPolygon::UvGridTriangulateInto(SMesh *mesh, SSurface *srf) {
     SEdgeList orig;
     ZERO(&orig);
@@ -446,12 +472,56 @@ void SPolygon::UvGridTriangulateInto(SMesh *mesh, SSurface *srf) {
     lj.Add(&v);
     srf->MakeTriangulationGridInto(&lj, 0, 1, false);
 
+    int ni = li.n - 1, nj = lj.n - 1, cells = ni*nj;
+
+    // Bin the trim edges by the grid cells that their bounding boxes touch,
+    // so that each quad tests only the edges near it, not all of them. An
+    // edge can't cross a side of the quad unless it comes within LENGTH_EPS,
+    // so grow the boxes by a bit more than that.
+    int *start = (int *)MemAlloc((cells + 1)*sizeof(int));
+    int *fill = (int *)MemAlloc((cells + 1)*sizeof(int));
+    int pass, i, j, k;
+    SEdge *se;
+    int *bin = NULL;
+    for(pass = 0; pass < 2; pass++) {
+        for(k = 0; k < orig.l.n; k++) {
+            se = &(orig.l.elem[k]);
+            double m = 10*LENGTH_EPS;
+            int i0 = GridCellOf(&li, min(se->a.x, se->b.x) - m),
+                i1 = GridCellOf(&li, max(se->a.x, se->b.x) + m),
+                j0 = GridCellOf(&lj, min(se->a.y, se->b.y) - m),
+                j1 = GridCellOf(&lj, max(se->a.y, se->b.y) + m);
+            for(i = i0; i <= i1; i++) {
+                for(j = j0; j <= j1; j++) {
+                    int c = i*nj + j;
+                    if(pass == 0) {
+                        start[c + 1]++;
+                    } else {
+                        bin[fill[c]++] = k;
+                    }
+                }
+            }
+        }
+        if(pass == 0) {
+            for(i = 0; i < cells; i++) {
+                start[i + 1] += start[i];
+                fill[i] = start[i];
+            }
+            bin = (int *)MemAlloc((start[cells] + 1)*sizeof(int));
+        }
+    }
+
     // Now iterate over each quad in the grid. If it's outside the polygon,
-    // or if it intersects the polygon, then we discard it. Otherwise we
-    // generate two triangles in the mesh, and cut it out of our polygon.
-    int i, j;
-    for(i = 0; i < (li.n - 1); i++) {
-        for(j = 0; j < (lj.n - 1); j++) {
+    // or if it intersects the polygon, then we discard it. Otherwise it
+    // will become two triangles in the mesh, cut out of our polygon.
+    bool *keep = (bool *)MemAlloc((cells + 1)*sizeof(bool));
+    for(i = 0; i < ni; i++) {
+        // A quad with no crossings has the same inside-ness as the one
+        // before it in the row, if that had no crossings too; the side
+        // between them is clear, unless a trim vertex lies exactly at a
+        // corner, since those don't count as crossings.
+        bool prevClean = false, prevIn = false;
+        for(j = 0; j < nj; j++) {
             double us = li.elem[i], uf = li.elem[i+1],
                    vs = lj.elem[j], vf = lj.elem[j+1];
 
@@ -460,21 +530,56 @@ void SPolygon::UvGridTriangulateInto(SMesh *mesh, SSurface *srf) {
                    c = Vector::From(uf, vf, 0),
                    d = Vector::From(uf, vs, 0);
 
-            if(orig.AnyEdgeCrossings(a, b, NULL) ||
-               orig.AnyEdgeCrossings(b, c, NULL) ||
-               orig.AnyEdgeCrossings(c, d, NULL) ||
-               orig.AnyEdgeCrossings(d, a, NULL))
-            {
+            int cell = i*nj + j;
+            bool clean = true, onCorner = false;
+            for(k = start[cell]; k < start[cell + 1]; k++) {
+                se = &(orig.l.elem[bin[k]]);
+                if(se->EdgeCrosses(a, b) || se->EdgeCrosses(b, c) ||
+                   se->EdgeCrosses(c, d) || se->EdgeCrosses(d, a))
+                {
+                    clean = false;
+                    break;
+                }
+                if(se->a.Equals(a) || se->b.Equals(a)) onCorner = true;
+            }
+            if(!clean) {
+                prevClean = false;
                 continue;
             }
 
-            // There's no intersections, so it doesn't matter which point
-            // we decide to test.
-            if(!this->ContainsPoint(a)) {
-                continue;
+            bool in;
+            if(prevClean && !onCorner) {
+                in = prevIn;
+            } else {
+                // There's no intersections, so it doesn't matter which
+                // point we decide to test.
+                in = this->ContainsPoint(a);
             }
+            keep[cell] = in;
+            // And don't pass on an answer that we got for a point right on
+            // the trim curve.
+            prevClean = !onCorner;
+            prevIn = in;
+        }
+    }
+
+    // Add the quads to our mesh, and the outline of the region that they
+    // cover to our holes. A side between two kept quads would appear in
+    // both directions and cancel, so add only the sides with no kept quad
+    // beyond them.
+    for(i = 0; i < ni; i++) {
+        for(j = 0; j < nj; j++) {
+            int cell = i*nj + j;
+            if(!keep[cell]) continue;
+
+            double us = li.elem[i], uf = li.elem[i+1],
+                   vs = lj.elem[j], vf = lj.elem[j+1];
+
+            Vector a = Vector::From(us, vs, 0),
+                   b = Vector::From(us, vf, 0),
+                   c = Vector::From(uf, vf, 0),
+                   d = Vector::From(uf, vs, 0);
 
-            // Add the quad to our mesh
             STriangle tr;
             ZERO(&tr);
             tr.a = a;
@@ -486,14 +591,18 @@ void SPolygon::UvGridTriangulateInto(SMesh *mesh, SSurface *srf) {
             tr.c = d;
             mesh->AddTriangle(&tr);
 
-            holes.AddEdge(a, b);
-            holes.AddEdge(b, c);
-            holes.AddEdge(c, d);
-            holes.AddEdge(d, a);
+            if(i == 0      || !keep[cell - nj]) holes.AddEdge(a, b);
+            if(j == nj - 1 || !keep[cell + 1])  holes.AddEdge(b, c);
+            if(i == ni - 1 || !keep[cell + nj]) holes.AddEdge(c, d);
+            if(j == 0      || !keep[cell - 1])  holes.AddEdge(d, a);
         }
     }
 
-    holes.CullExtraneousEdges();
+    MemFree(start);
+    MemFree(fill);
+    MemFree(bin);
+    MemFree(keep);
+
     SPolygon hp;
     ZERO(&hp);
     holes.AssemblePolygon(&hp, NULL, true);
@@ -512,4 +621,471 @@ void SPolygon::UvGridTriangulateInto(SMesh *mesh, SSurface *srf) {
     UvTriangulateInto(mesh, srf);
 }
 
+//-----------------------------------------------------------------------------
+// Triangulate a plane, with any number of holes, by sweeping a line down
+// through it in y. The sweep adds diagonals that cut the polygon in to
+// pieces that are monotone in y, and each of those pieces is then easy to
+// triangulate. That costs a sort, plus a binary search of the edges that
+// cross the sweep line at most vertices; so it's much faster than ear
+// clipping for big polygons, like text or fine arcs. But it doesn't cope
+// with contours that share a vertex, so when anything looks degenerate we
+// give up and let the caller clip ears instead.
+//-----------------------------------------------------------------------------
+class SweepTriangulator {
+public:
+    static const int START      = 0;
+    static const int END        = 1;
+    static const int SPLIT      = 2;
+    static const int MERGE      = 3;
+    static const int REGULAR    = 4;
+
+    int         n;
+    Vector     *pt;
+    int        *prev, *next;
+    int        *type;
+    int        *order;
+    // The vertex that's helper for the edge from each vertex to the next,
+    // and the edges that currently cross the sweep line, sorted by x.
+    int        *helper;
+    int        *active;
+    int         actives;
+    // The diagonals, as a pair of vertices each; there's at most two for
+    // each vertex.
+    int        *diag;
+    int         diags;
+
+    List<STriangle> tris;
+    // The area of the polygon, and of the triangles that we've made.
+    double      area, covered;
+    double      eps;
+
+    static Vector *sortPt;
+    static bool Above(Vector a, Vector b) {
+        return (a.y > b.y) || (a.y == b.y && a.x < b.x);
+    }
+    static int ByHeight(const void *av, const void *bv) {
+        Vector a = sortPt[*((int *)av)],
+               b = sortPt[*((int *)bv)];
+        if(Above(a, b)) return -1;
+        if(Above(b, a)) return 1;
+        return 0;
+    }
+    static double Orient(Vector a, Vector b, Vector c) {
+        return (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+    }
+
+    bool LoadFrom(SPolygon *sp);
+    double XAt(int e, double y);
+    int ActiveLeftOf(Vector p, bool orOn);
+    int EdgeLeftOf(int v);
+    void InsertActive(int e);
+    bool RemoveActive(int e);
+    void AddDiagonal(int a, int b);
+    bool Sweep(void);
+    bool Emit(int a, int b, int c);
+    bool TriangulateMonotone(int *f, int m, bool *left);
+    bool TriangulatePieces(void);
+    void Clear(void);
+};
+Vector *SweepTriangulator::sortPt;
+
+bool SweepTriangulator::LoadFrom(SPolygon *sp) {
+    int i, j;
+    n = 0;
+    for(i = 0; i < sp->l.n; i++) {
+        n += sp->l.elem[i].l.n;
+    }
+    pt     = (Vector *)MemAlloc((n + 1)*sizeof(Vector));
+    prev   = (int *)MemAlloc((n + 1)*sizeof(int));
+    next   = (int *)MemAlloc((n + 1)*sizeof(int));
+    type   = (int *)MemAlloc((n + 1)*sizeof(int));
+    order  = (int *)MemAlloc((n + 1)*sizeof(int));
+    helper = (int *)MemAlloc((n + 1)*sizeof(int));
+    active = (int *)MemAlloc((n + 1)*sizeof(int));
+    diag   = (int *)MemAlloc((4*n + 1)*sizeof(int));
+
+    n = 0;
+    area = 0;
+    for(i = 0; i < sp->l.n; i++) {
+        SContour *sc = &(sp->l.elem[i]);
+        // The last point repeats the first; and drop any zero-length edges,
+        // same as when we clip ears.
+        int start = n;
+        for(j = 0; j < sc->l.n - 1; j++) {
+            Vector p = sc->l.elem[j].p;
+            if(n > start && p.Equals(pt[n-1])) continue;
+            pt[n++] = p;
+        }
+        while(n - start > 1 && pt[n-1].Equals(pt[start])) n--;
+        if(n - start < 3) return false;
+
+        // Outer contours go counterclockwise, and holes clockwise.
+        double a = 0;
+        for(j = start; j < n; j++) {
+            Vector p0 = pt[j], p1 = pt[(j + 1 < n) ? j + 1 : start];
+            a += (p0.x - p1.x)*(p0.y + p1.y);
+        }
+        a /= 2;
+        if(a == 0) return false;
+        bool ccw = (sc->timesEnclosed % 2 == 0);
+        if((a > 0) != ccw) {
+            for(j = 0; j < (n - start)/2; j++) {
+                SWAP(Vector, pt[start + j], pt[n - 1 - j]);
+            }
+        }
+        area += fabs(a)*(ccw ? 1 : -1);
+        for(j = start; j < n; j++) {
+            next[j] = (j + 1 < n) ? j + 1 : start;
+            prev[j] = (j > start) ? j - 1 : n - 1;
+        }
+    }
+    if(area <= 0) return false;
+
+    for(i = 0; i < n; i++) {
+        order[i] = i;
+
+        Vector p = pt[i], pp = pt[prev[i]], pn = pt[next[i]];
+        bool prevAbove = Above(pp, p), nextAbove = Above(pn, p);
+        double o = Orient(pp, p, pn);
+        if(!prevAbove && !nextAbove) {
+            if(o == 0) return false;
+            type[i] = (o > 0) ? START : SPLIT;
+        } else if(prevAbove && nextAbove) {
+            if(o == 0) return false;
+            type[i] = (o > 0) ? END : MERGE;
+        } else {
+            type[i] = REGULAR;
+        }
+    }
+    sortPt = pt;
+    qsort(order, n, sizeof(order[0]), ByHeight);
+    // Two contours that share a vertex would need special handling.
+    for(i = 1; i < n; i++) {
+        if(pt[order[i]].EqualsExactly(pt[order[i-1]])) return false;
+    }
+    return true;
+}
+
+double SweepTriangulator::XAt(int e, double y) {
+    Vector a = pt[e], b = pt[next[e]];
+    if(a.y == b.y) return min(a.x, b.x);
+    return a.x + (y - a.y)*(b.x - a.x)/(b.y - a.y);
+}
+
+//-----------------------------------------------------------------------------
+// The number of active edges that cross the sweep line left of p (or on it,
+// if orOn). The edges don't cross, so they stay sorted as the line moves,
+// and we can binary search.
+//-----------------------------------------------------------------------------
+int SweepTriangulator::ActiveLeftOf(Vector p, bool orOn) {
+    int lo = 0, hi = actives;
+    while(lo < hi) {
+        int mid = (lo + hi)/2;
+        double x = XAt(active[mid], p.y);
+        if(x < p.x || (orOn && x == p.x)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int SweepTriangulator::EdgeLeftOf(int v) {
+    int i = ActiveLeftOf(pt[v], true);
+    return (i > 0) ? active[i - 1] : -1;
+}
+
+void SweepTriangulator::InsertActive(int e) {
+    int i = ActiveLeftOf(pt[e], false);
+    memmove(&(active[i + 1]), &(active[i]), (actives - i)*sizeof(active[0]));
+    active[i] = e;
+    actives++;
+}
+
+bool SweepTriangulator::RemoveActive(int e) {
+    // The edge ends on the sweep line, so binary search for its lower
+    // end. Rounding in XAt() might put the edge just either side of that,
+    // among the few other edges through the same point, so look outwards.
+    int hi = ActiveLeftOf(pt[next[e]], false), lo = hi - 1, i;
+    for(;;) {
+        if(hi < actives && active[hi] == e) {
+            i = hi;
+            break;
+        }
+        if(lo >= 0 && active[lo] == e) {
+            i = lo;
+            break;
+        }
+        if(lo < 0 && hi >= actives) return false;
+        lo--;
+        hi++;
+    }
+    memmove(&(active[i]), &(active[i + 1]), (actives - 1 - i)*sizeof(active[0]));
+    actives--;
+    return true;
+}
+
+void SweepTriangulator::AddDiagonal(int a, int b) {
+    diag[diags++] = a;
+    diag[diags++] = b;
+}
+
+bool SweepTriangulator::Sweep(void) {
+    int k;
+    for(k = 0; k < n; k++) {
+        int v = order[k], e = prev[v], j;
+        switch(type[v]) {
+            case START:
+                InsertActive(v);
+                helper[v] = v;
+                break;
+
+            case END:
+                if(type[helper[e]] == MERGE) AddDiagonal(v, helper[e]);
+                if(!RemoveActive(e)) return false;
+                break;
+
+            case SPLIT:
+                if((j = EdgeLeftOf(v)) < 0) return false;
+                AddDiagonal(v, helper[j]);
+                helper[j] = v;
+                InsertActive(v);
+                helper[v] = v;
+                break;
+
+            case MERGE:
+                if(type[helper[e]] == MERGE) AddDiagonal(v, helper[e]);
+                if(!RemoveActive(e)) return false;
+                if((j = EdgeLeftOf(v)) < 0) return false;
+                if(type[helper[j]] == MERGE) AddDiagonal(v, helper[j]);
+                helper[j] = v;
+                break;
+
+            case REGULAR:
+                if(Above(pt[e], pt[v])) {
+                    // The interior lies to our right.
+                    if(type[helper[e]] == MERGE) AddDiagonal(v, helper[e]);
+                    if(!RemoveActive(e)) return false;
+                    InsertActive(v);
+                    helper[v] = v;
+                } else {
+                    if((j = EdgeLeftOf(v)) < 0) return false;
+                    if(type[helper[j]] == MERGE) AddDiagonal(v, helper[j]);
+                    helper[j] = v;
+                }
+                break;
+        }
+    }
+    return true;
+}
+
+bool SweepTriangulator::Emit(int a, int b, int c) {
+    // That's counterclockwise, if the pieces are right.
+    double o = Orient(pt[a], pt[b], pt[c]);
+    if(o < -eps*eps) return false;
+    covered += o/2;
+    if(o < eps*eps) {
+        // A zero-area triangle, from collinear edges; so cull it.
+        return true;
+    }
+    // And clockwise in the mesh, same as when we clip ears.
+    STriangle tr;
+    ZERO(&tr);
+    tr.a = pt[a];
+    tr.b = pt[c];
+    tr.c = pt[b];
+    tris.Add(&tr);
+    return true;
+}
+
+bool SweepTriangulator::TriangulateMonotone(int *f, int m, bool *left) {
+    int i;
+    if(m < 3) return false;
+
+    // Find the top and bottom; walking counterclockwise from the top takes
+    // us down the left chain to the bottom, and then back up the right.
+    int top = 0, bot = 0;
+    for(i = 1; i < m; i++) {
+        if(Above(pt[f[i]], pt[f[top]])) top = i;
+        if(Above(pt[f[bot]], pt[f[i]])) bot = i;
+    }
+    for(i = top; i != bot; i = (i + 1) % m) {
+        int i1 = (i + 1) % m;
+        if(!Above(pt[f[i]], pt[f[i1]])) return false;
+        left[f[i]] = true;
+    }
+    for(i = bot; i != top; i = (i + 1) % m) {
+        int i1 = (i + 1) % m;
+        if(!Above(pt[f[i1]], pt[f[i]])) return false;
+        left[f[i]] = false;
+    }
 
+    int *u = (int *)MemAlloc(2*m*sizeof(int)), *s = u + m;
+    for(i = 0; i < m; i++) u[i] = f[i];
+    sortPt = pt;
+    qsort(u, m, sizeof(u[0]), ByHeight);
+
+    bool ok = true;
+    int sp = 0, j;
+    s[sp++] = u[0];
+    s[sp++] = u[1];
+    for(j = 2; j < m - 1 && ok; j++) {
+        int uj = u[j];
+        if(left[uj] != left[s[sp-1]]) {
+            // On the opposite chain, so everything on the stack is visible.
+            for(; sp > 1 && ok; sp--) {
+                int a = s[sp-1], b = s[sp-2];
+                ok = left[uj] ? Emit(uj, a, b) : Emit(b, a, uj);
+            }
+            sp = 0;
+            s[sp++] = u[j-1];
+            s[sp++] = uj;
+        } else {
+            // Same chain, so clip as long as the diagonal is inside.
+            int last = s[--sp];
+            while(sp > 0 && ok) {
+                int s2 = s[sp-1];
+                if(left[uj]) {
+                    if(Orient(pt[s2], pt[last], pt[uj]) <= 0) break;
+                    ok = Emit(s2, last, uj);
+                } else {
+                    if(Orient(pt[uj], pt[last], pt[s2]) <= 0) break;
+                    ok = Emit(uj, last, s2);
+                }
+                last = s[--sp];
+            }
+            s[sp++] = last;
+            s[sp++] = uj;
+        }
+    }
+    // And the bottom sees everything that's left on the stack.
+    int ub = u[m-1];
+    for(; sp > 1 && ok; sp--) {
+        int a = s[sp-1], b = s[sp-2];
+        ok = left[a] ? Emit(b, a, ub) : Emit(ub, a, b);
+    }
+
+    MemFree(u);
+    return ok;
+}
+
+bool SweepTriangulator::TriangulatePieces(void) {
+    // The half-edges: the edges of the contours, each with the interior to
+    // its left, then the diagonals in both directions.
+    int h, nh = n + diags;
+    int *from  = (int *)MemAlloc((nh + 1)*sizeof(int)),
+        *to    = (int *)MemAlloc((nh + 1)*sizeof(int)),
+        *nexth = (int *)MemAlloc((nh + 1)*sizeof(int)),
+        *first = (int *)MemAlloc((n + 2)*sizeof(int)),
+        *out   = (int *)MemAlloc((nh + 1)*sizeof(int));
+    double *angle = (double *)MemAlloc((nh + 1)*sizeof(double));
+    bool *left = (bool *)MemAlloc((n + 1)*sizeof(bool)),
+         *used = (bool *)MemAlloc((nh + 1)*sizeof(bool));
+
+    for(h = 0; h < n; h++) {
+        from[h] = h;
+        to[h] = next[h];
+    }
+    for(h = 0; h < diags; h++) {
+        from[n + h] = diag[h];
+        to[n + h] = diag[h ^ 1];
+    }
+    // Sort them by the vertex they leave from.
+    for(h = 0; h < nh; h++) {
+        first[from[h] + 1]++;
+        Vector d = pt[to[h]].Minus(pt[from[h]]);
+        angle[h] = atan2(d.y, d.x);
+    }
+    int i;
+    for(i = 0; i < n; i++) first[i+1] += first[i];
+    int *fill = (int *)MemAlloc((n + 1)*sizeof(int));
+    for(h = 0; h < nh; h++) {
+        out[first[from[h]] + fill[from[h]]++] = h;
+    }
+    MemFree(fill);
+
+    // Walking a piece counterclockwise, we leave each vertex along the
+    // first half-edge clockwise from the one that we came in on.
+    for(h = 0; h < nh; h++) {
+        int v = to[h], k, best = -1;
+        double back = atan2(pt[from[h]].y - pt[v].y, pt[from[h]].x - pt[v].x),
+               bestTurn = VERY_POSITIVE;
+        for(k = first[v]; k < first[v+1]; k++) {
+            int g = out[k];
+            if(to[g] == from[h]) continue;
+            double turn = back - angle[g];
+            while(turn <= 0) turn += 2*PI;
+            while(turn > 2*PI) turn -= 2*PI;
+            if(turn < bestTurn) {
+                bestTurn = turn;
+                best = g;
+            }
+        }
+        nexth[h] = best;
+    }
+
+    bool ok = true;
+    // The vertices of each piece in turn, walking counterclockwise.
+    int *f = (int *)MemAlloc((nh + 1)*sizeof(int)), m;
+    for(h = 0; h < nh && ok; h++) {
+        if(used[h]) continue;
+        m = 0;
+        int g = h;
+        do {
+            if(g < 0 || used[g] || m > nh) {
+                ok = false;
+                break;
+            }
+            used[g] = true;
+            f[m++] = from[g];
+            g = nexth[g];
+        } while(g != h);
+        if(ok) ok = TriangulateMonotone(f, m, left);
+    }
+    MemFree(f);
+
+    MemFree(from);
+    MemFree(to);
+    MemFree(nexth);
+    MemFree(first);
+    MemFree(out);
+    MemFree(angle);
+    MemFree(left);
+    MemFree(used);
+    return ok;
+}
+
+void SweepTriangulator::Clear(void) {
+    MemFree(pt);
+    MemFree(prev);
+    MemFree(next);
+    MemFree(type);
+    MemFree(order);
+    MemFree(helper);
+    MemFree(active);
+    MemFree(diag);
+    tris.Clear();
+}
+
+bool SPolygon::SweepTriangulateInto(SMesh *m, SSurface *srf) {
+    Vector tu, tv;
+    srf->TangentsAt(0.5, 0.5, &tu, &tv);
+    double s = sqrt(tu.MagSquared() + tv.MagSquared());
+
+    SweepTriangulator st;
+    ZERO(&st);
+    st.eps = LENGTH_EPS / s;
+
+    bool ok = st.LoadFrom(this) && st.Sweep() && st.TriangulatePieces();
+    // The pieces should exactly cover the polygon.
+    if(ok && fabs(st.covered - st.area) > 1e-6*st.area) ok = false;
+    if(ok) {
+        int i;
+        for(i = 0; i < st.tris.n; i++) {
+            m->AddTriangle(&(st.tris.elem[i]));
+        }
+    }
+    st.Clear();
+    return ok;
+}
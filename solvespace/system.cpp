@@ -22,6 +22,11 @@ const double System::CONVERGE_TOLERANCE = (LENGTH_EPS/(1e2));
 bool System::WriteJacobian(int tag) {
     int a, i, j;
 
+    // Any compiled code refers to the old expressions.
+    jacobianProgram.Clear();
+    residualProgram.Clear();
+    compiled = false;
+
     j = 0;
     for(a = 0; a < param.n; a++) {
         if(j >= MAX_UNKNOWNS) return false;
@@ -32,6 +37,7 @@ bool System::WriteJacobian(int tag) {
         j++;
     }
     mat.n = j;
+    dual = (mat.n <= Expr::MAX_DUAL);
 
     i = 0;
     for(a = 0; a < eq.n; a++) {
@@ -45,8 +51,8 @@ bool System::WriteJacobian(int tag) {
         f = f->FoldConstants();
 
         // Hash table (61 bits) to accelerate generation of zero partials.
-        QWORD scoreboard = f->ParamsUsed();
-        for(j = 0; j < mat.n; j++) {
+        QWORD scoreboard = dual ? 0 : f->ParamsUsed();
+        for(j = 0; j < mat.n && !dual; j++) {
             Expr *pd;
             if(scoreboard & ((QWORD)1 << (mat.param[j].v % 61)) &&
                 f->DependsOn(mat.param[j]))
@@ -67,7 +73,42 @@ bool System::WriteJacobian(int tag) {
     return true;
 }
 
+void System::CompileJacobian(void) {
+    int i, j;
+    for(i = 0; i < mat.m; i++) {
+        for(j = 0; j < mat.n && !dual; j++) {
+            jacobianProgram.Add(mat.A.sym[i][j], &(mat.A.num[i][j]));
+        }
+        residualProgram.Add(mat.B.sym[i], &(mat.B.num[i]));
+    }
+    jacobianProgram.Finish();
+    residualProgram.Finish();
+    compiled = true;
+}
+
+void System::EvalResiduals(void) {
+    if(compiled) {
+        residualProgram.Eval();
+        return;
+    }
+    int i;
+    for(i = 0; i < mat.m; i++) {
+        mat.B.num[i] = (mat.B.sym[i])->Eval();
+    }
+}
+
 void System::EvalJacobian(void) {
+    if(dual) {
+        int i;
+        for(i = 0; i < mat.m; i++) {
+            (mat.B.sym[i])->EvalDual(mat.param, mat.n, mat.A.num[i]);
+        }
+        return;
+    }
+    if(compiled) {
+        jacobianProgram.Eval();
+        return;
+    }
     int i, j;
     for(i = 0; i < mat.m; i++) {
         for(j = 0; j < mat.n; j++) {
@@ -279,11 +320,15 @@ bool System::NewtonSolve(int tag) {
     bool converged = false;
     int i;
 
+    // The blocks that we solve alone are one equation in one unknown, and
+    // converge in a few iterations; not worth compiling those.
+    if(tag == 0 && !compiled) CompileJacobian();
+
     // Evaluate the functions at our operating point.
-    for(i = 0; i < mat.m; i++) {
-        mat.B.num[i] = (mat.B.sym[i])->Eval();
-    }
+    EvalResiduals();
     do {
+        if(CheckTimedOut()) return false;
+
         // And evaluate the Jacobian at our initial operating point.
         EvalJacobian();
 
@@ -301,9 +346,7 @@ bool System::NewtonSolve(int tag) {
         }
 
         // Re-evalute the functions, since the params have just changed.
-        for(i = 0; i < mat.m; i++) {
-            mat.B.num[i] = (mat.B.sym[i])->Eval();
-        }
+        EvalResiduals();
         // Check for convergence
         converged = true;
         for(i = 0; i < mat.m; i++) {
@@ -317,9 +360,69 @@ bool System::NewtonSolve(int tag) {
         }
     } while(iter++ < 50 && !converged);
 
+    if(stats) {
+        stats->iterations += iter;
+        if(stats->blocks < stats->blockSpace) {
+            stats->blockIterations[stats->blocks] = iter;
+        }
+        stats->blocks++;
+    }
     return converged;
 }
 
+//-----------------------------------------------------------------------------
+// For a sweep of the dimension of constraint c, predict where the params
+// will be when its valA becomes vnext, starting from the solution at its
+// current valA (which must be in our param table). To first order, they
+// move along the tangent to the solution curve,
+//      dx = -J^+ (dF/dvalA) dvalA
+// and since x is held fixed, (dF/dvalA) dvalA is just the change in the
+// residuals of c's equations when we change the dimension.
+//-----------------------------------------------------------------------------
+bool System::PredictContinuation(Group *g, ConstraintBase *c, double vnext) {
+    eq.Clear();
+    WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
+    param.ClearTags();
+    eq.ClearTags();
+
+    // No substitution here; the corrector will do that, but we want the
+    // tangent in terms of every param.
+    if(!WriteJacobian(0) || mat.m > mat.n) {
+        eq.Clear();
+        return false;
+    }
+    EvalJacobian();
+
+    IdList<Equation,hEquation> l;
+    ZERO(&l);
+    double vprev = c->valA;
+    c->valA = vnext;
+    c->GenerateReal(&l);
+    c->valA = vprev;
+
+    int i;
+    for(i = 0; i < mat.m; i++) {
+        Equation *e = l.FindByIdNoOops(mat.eq[i]);
+        if(e) {
+            Expr *f = e->e->DeepCopyWithParamsAsPointers(&param, &(SK.param));
+            mat.B.num[i] = f->Eval() - (mat.B.sym[i])->Eval();
+        } else {
+            mat.B.num[i] = 0;
+        }
+    }
+    l.Clear();
+    eq.Clear();
+
+    if(!SolveLeastSquares()) return false;
+
+    for(i = 0; i < mat.n; i++) {
+        Param *p = param.FindById(mat.param[i]);
+        p->val -= mat.X[i];
+        if(isnan(p->val)) return false;
+    }
+    return true;
+}
+
 void System::WriteEquationsExceptFor(hConstraint hc, Group *g) {
     int i;
     // Generate all the equations from constraints in this group
@@ -345,13 +448,18 @@ void System::WriteEquationsExceptFor(hConstraint hc, Group *g) {
 
         c->Generate(&eq);
     }
-    // And the equations from entities
+    // And the equations from entities; those need to know which points
+    // are constrained coincident, so index that just once.
+    CoincidentIndex coincident;
+    ZERO(&coincident);
+    coincident.Build(g->h);
     for(i = 0; i < SK.entity.n; i++) {
         EntityBase *e = &(SK.entity.elem[i]);
         if(e->group.v != g->h.v) continue;
 
-        e->GenerateEquations(&eq);
+        e->GenerateEquations(&eq, &coincident);
     }
+    coincident.Clear();
     // And from the groups themselves
     g->GenerateEquations(&eq);
 }
@@ -363,6 +471,7 @@ void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad) {
         for(i = 0; i < SK.constraint.n; i++) {
             ConstraintBase *c = &(SK.constraint.elem[i]);
             if(c->group.v != g->h.v) continue;
+            if(CheckTimedOut()) return;
             if((c->type == Constraint::POINTS_COINCIDENT && a == 0) ||
                (c->type != Constraint::POINTS_COINCIDENT && a == 1))
             {
@@ -393,14 +502,82 @@ void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Have we run past the caller's deadline, or been asked to stop? Once that
+// happens, it stays that way until the next Solve().
+//-----------------------------------------------------------------------------
+bool System::CheckTimedOut(void) {
+    if(timedOut) return true;
+
+    if(cancel && *cancel) {
+        timedOut = true;
+    } else if(haveDeadline && (GetMilliseconds() - deadline) >= 0) {
+        timedOut = true;
+    }
+    return timedOut;
+}
+
+//-----------------------------------------------------------------------------
+// Bound each equation over every possible value of the unknowns; if zero
+// isn't within those bounds, then no solution can exist, whatever Newton's
+// method does. That's cheap, and catches things like a negative distance
+// without iterating. The constraints that generated those equations are
+// added to bad (if non-NULL), and we return true if there were any.
+//-----------------------------------------------------------------------------
+bool System::FindImpossibleEquations(List<hConstraint> *bad) {
+    bool any = false;
+    int i;
+
+    SK.constraint.ClearTags();
+    for(i = 0; i < eq.n; i++) {
+        Equation *e = &(eq.elem[i]);
+        double lo, hi;
+        e->e->EvalInterval(&param, &lo, &hi);
+        if(lo <= CONVERGE_TOLERANCE + 1e-9*ffabs(lo) &&
+           hi >= -(CONVERGE_TOLERANCE + 1e-9*ffabs(hi)))
+        {
+            continue;
+        }
+        any = true;
+
+        if(!bad || !e->h.isFromConstraint()) continue;
+        ConstraintBase *c = SK.constraint.FindByIdNoOops(e->h.constraint());
+        if(!c || c->tag) continue;
+        c->tag = 1;
+        bad->Add(&(c->h));
+    }
+    return any;
+}
+
+//-----------------------------------------------------------------------------
+// For the optional stats; if we're not collecting them, then don't waste
+// time reading the clock.
+//-----------------------------------------------------------------------------
+SQWORD System::StartTimer(void) {
+    return stats ? GetMicroseconds() : 0;
+}
+
 int System::Solve(Group *g, int *dof, List<hConstraint> *bad, 
                   bool andFindBad, bool andFindFree)
 {
+    timedOut = false;
+    canSolveAgain = false;
+    aloneBlock.Clear();
+
+    SQWORD t0 = StartTimer();
     WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
+    if(stats) stats->generateTime += GetMicroseconds() - t0;
+
+    // An equation that can't be satisfied for any values of the unknowns
+    // makes the system inconsistent, and there's no point solving.
+    t0 = StartTimer();
+    bool impossible = FindImpossibleEquations(andFindBad ? bad : NULL);
+    if(stats) stats->diagnoseTime += GetMicroseconds() - t0;
+    if(impossible) return System::SINGULAR_JACOBIAN;
 
     int i, j = 0;
 
-    int rank;
+    bool converged;
     
 /*
     dbp("%d equations", eq.n);
@@ -416,7 +593,19 @@ int System::Solve(Group *g, int *dof, List<hConstraint> *bad,
     param.ClearTags();
     eq.ClearTags();
     
+    t0 = StartTimer();
     SolveBySubstitution();
+    if(stats) {
+        stats->substituteTime += GetMicroseconds() - t0;
+        stats->equations += eq.n;
+        stats->params += param.n;
+        for(i = 0; i < eq.n; i++) {
+            if(eq.elem[i].tag != EQ_SUBSTITUTED) stats->equationsLeft++;
+        }
+        for(i = 0; i < param.n; i++) {
+            if(param.elem[i].tag != VAR_SUBSTITUTED) stats->paramsLeft++;
+        }
+    }
 
     // Before solving the big system, see if we can find any equations that
     // are soluble alone. This can be a huge speedup. We don't know whether
@@ -436,26 +625,139 @@ int System::Solve(Group *g, int *dof, List<hConstraint> *bad,
 
         e->tag = alone;
         p->tag = alone;
+        t0 = StartTimer();
         WriteJacobian(alone);
-        if(!NewtonSolve(alone)) {
+        // Remember this block, in case we're asked to solve again.
+        AloneBlock ab;
+        ab.tag = alone;
+        ab.param = mat.param[0];
+        ab.eq = mat.eq[0];
+        ab.f = mat.B.sym[0];
+        aloneBlock.Add(&ab);
+        converged = NewtonSolve(alone);
+        if(stats) stats->newtonTime += GetMicroseconds() - t0;
+        if(!converged) {
+            if(timedOut) return ReportTimedOut();
             // Failed to converge, bail out early
-            goto didnt_converge;
+            return ReportDidntConverge(bad);
         }
         alone++;
     }
 
     // Now write the Jacobian for what's left, and do a rank test; that
     // tells us if the system is inconsistently constrained.
+    t0 = StartTimer();
     if(!WriteJacobian(0)) {
         return System::TOO_MANY_UNKNOWNS;
     }
 
     EvalJacobian();
+    if(stats) {
+        stats->jacobianTime += GetMicroseconds() - t0;
+        for(i = 0; i < mat.m; i++) {
+            stats->exprNodes += mat.B.sym[i]->Nodes();
+            for(j = 0; j < mat.n && !dual; j++) {
+                stats->exprNodes += mat.A.sym[i][j]->Nodes();
+            }
+        }
+    }
+
+    // That's everything written, so we could solve all this again, unless
+    // we write something else over it below.
+    canSolveAgain = !andFindFree;
+    return SolveWrittenJacobian(g, dof, bad, andFindBad, andFindFree);
+}
+
+//-----------------------------------------------------------------------------
+// Solve the same equations as the last call to Solve (which must have left
+// canSolveAgain set), for new values of the params in our param table, and
+// new values of any constraint's valAParam. The equations, the Jacobian, and
+// its compiled code are all reused, so this is much faster than solving from
+// scratch. It doesn't look for the bad constraints, or for free params.
+//-----------------------------------------------------------------------------
+int System::SolveAgain(int *dof, List<hConstraint> *bad) {
+    if(!canSolveAgain) oops();
+    timedOut = false;
+
+    SQWORD t0 = StartTimer();
+    bool impossible = FindImpossibleEquations(NULL);
+    if(stats) stats->diagnoseTime += GetMicroseconds() - t0;
+    if(impossible) return System::SINGULAR_JACOBIAN;
+
+    // The blocks that we solve alone use just the first row and column of
+    // the matrix, so keep those for the big system.
+    int m = mat.m, n = mat.n;
+    hParam p0 = mat.param[0];
+    hEquation e0 = mat.eq[0];
+    Expr *f0 = mat.B.sym[0];
+    bool wasDual = dual, wasCompiled = compiled;
+
+    bool converged = true;
+    int i;
+    t0 = StartTimer();
+    for(i = 0; i < aloneBlock.n && converged; i++) {
+        AloneBlock *ab = &(aloneBlock.elem[i]);
+        mat.m = mat.n = 1;
+        mat.param[0] = ab->param;
+        mat.eq[0] = ab->eq;
+        mat.B.sym[0] = ab->f;
+        dual = true;
+        compiled = false;
+        converged = NewtonSolve(ab->tag);
+    }
+    if(stats) stats->newtonTime += GetMicroseconds() - t0;
+    if(!converged) {
+        int how = timedOut ? ReportTimedOut() : ReportDidntConverge(bad);
+        mat.m = m;
+        mat.n = n;
+        mat.param[0] = p0;
+        mat.eq[0] = e0;
+        mat.B.sym[0] = f0;
+        dual = wasDual;
+        compiled = wasCompiled;
+        return how;
+    }
+    mat.m = m;
+    mat.n = n;
+    mat.param[0] = p0;
+    mat.eq[0] = e0;
+    mat.B.sym[0] = f0;
+    dual = wasDual;
+    compiled = wasCompiled;
+
+    t0 = StartTimer();
+    EvalJacobian();
+    if(stats) stats->jacobianTime += GetMicroseconds() - t0;
+
+    return SolveWrittenJacobian(NULL, dof, bad, false, false);
+}
+
+//-----------------------------------------------------------------------------
+// With the Jacobian for the big system written and evaluated, do the rank
+// test, solve it, and write the solution back in to the sketch.
+//-----------------------------------------------------------------------------
+int System::SolveWrittenJacobian(Group *g, int *dof, List<hConstraint> *bad,
+                                 bool andFindBad, bool andFindFree)
+{
+    int i, rank;
+    bool converged;
+    SQWORD t0;
+
+    if(CheckTimedOut()) return ReportTimedOut();
 
+    t0 = StartTimer();
     rank = CalculateRank();
+    if(stats) stats->rankTime += GetMicroseconds() - t0;
     if(rank != mat.m) {
         if(andFindBad) {
+            // That writes the equations again, so there's nothing left to
+            // solve again.
+            canSolveAgain = false;
+            t0 = StartTimer();
             FindWhichToRemoveToFixJacobian(g, bad);
+            if(stats) stats->diagnoseTime += GetMicroseconds() - t0;
+            // and report whatever we'd found by then
+            if(timedOut) return System::TIMED_OUT;
         }
         return System::SINGULAR_JACOBIAN;
     }
@@ -465,18 +767,23 @@ int System::Solve(Group *g, int *dof, List<hConstraint> *bad,
     if(dof) *dof = mat.n - mat.m;
 
     // And do the leftovers as one big system
-    if(!NewtonSolve(0)) {
-        goto didnt_converge;
+    t0 = StartTimer();
+    converged = NewtonSolve(0);
+    if(stats) stats->newtonTime += GetMicroseconds() - t0;
+    if(!converged) {
+        if(timedOut) return ReportTimedOut();
+        return ReportDidntConverge(bad);
     }
 
     // If requested, find all the free (unbound) variables. This might be
     // more than the number of degrees of freedom. Don't always do this,
     // because the display would get annoying and it's slow.
+    t0 = StartTimer();
     for(i = 0; i < param.n; i++) {
         Param *p = &(param.elem[i]);
         p->free = false;
 
-        if(andFindFree) {
+        if(andFindFree && !CheckTimedOut()) {
             if(p->tag == 0) {
                 p->tag = VAR_DOF_TEST;
                 WriteJacobian(0);
@@ -489,6 +796,7 @@ int System::Solve(Group *g, int *dof, List<hConstraint> *bad,
             }
         }
     }
+    if(stats) stats->diagnoseTime += GetMicroseconds() - t0;
 
     // System solved correctly, so write the new values back in to the
     // main parameter table.
@@ -506,8 +814,27 @@ int System::Solve(Group *g, int *dof, List<hConstraint> *bad,
         pp->free = p->free;
     }
     return System::SOLVED_OKAY;
+}
+
+int System::ReportTimedOut(void) {
+    // We didn't finish, but the caller gets the best solution we'd found
+    // so far, though it's not marked as known.
+    int i;
+    for(i = 0; i < param.n; i++) {
+        Param *p = &(param.elem[i]);
+        double val;
+        if(p->tag == VAR_SUBSTITUTED) {
+            val = param.FindById(p->substd)->val;
+        } else {
+            val = p->val;
+        }
+        SK.GetParam(p->h)->val = val;
+    }
+    return System::TIMED_OUT;
+}
 
-didnt_converge:
+int System::ReportDidntConverge(List<hConstraint> *bad) {
+    int i;
     SK.constraint.ClearTags();
     for(i = 0; i < eq.n; i++) {
         if(ffabs(mat.B.num[i]) > CONVERGE_TOLERANCE || isnan(mat.B.num[i])) {
@@ -43,12 +43,18 @@ void GetAbsoluteFilename(char *file)
 // to be sloppy with our memory management, and just free everything at once
 // at the end.
 //-----------------------------------------------------------------------------
+static QWORD TempBytes;
+
 void *AllocTemporary(int n)
 {
     void *v = HeapAlloc(TempHeap, HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY, n);
     if(!v) oops();
+    TempBytes += n;
     return v;
 }
+QWORD TemporaryBytesAllocated(void) {
+    return TempBytes;
+}
 void FreeTemporary(void *p) {
     HeapFree(TempHeap, HEAP_NO_SERIALIZE, p);
 }
@@ -79,6 +85,21 @@ void MemFree(void *p) {
     HeapFree(PermHeap, HEAP_NO_SERIALIZE, p);
 }
 
+// Memory for code that we generate at runtime; it's writable until
+// MakeExecutable(), and executable (but no longer writable) after.
+void *AllocExecutable(int n) {
+    return VirtualAlloc(NULL, n, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+bool MakeExecutable(void *p, int n) {
+    DWORD old;
+    if(!VirtualProtect(p, n, PAGE_EXECUTE_READ, &old)) return false;
+    FlushInstructionCache(GetCurrentProcess(), p, n);
+    return true;
+}
+void FreeExecutable(void *p, int n) {
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
 void vl(void) {
     if(!HeapValidate(TempHeap, HEAP_NO_SERIALIZE, NULL)) oops();
     if(!HeapValidate(PermHeap, HEAP_NO_SERIALIZE, NULL)) oops();
@@ -91,9 +112,32 @@ void InitHeaps(void) {
     FreeAllTemporary();
 }
 
+SQWORD GetMicroseconds(void)
+{
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (SQWORD)((t.QuadPart*1000000.0)/f.QuadPart);
+}
+
+#ifdef LIBRARY
+// The GUI gets this from w32main.cpp, but the library needs it too, for
+// the solver's deadline.
+SDWORD GetMilliseconds(void)
+{
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    LONGLONG d = t.QuadPart/(f.QuadPart/1000);
+    return (SDWORD)d;
+}
+#endif
+
 #else   // not WIN32
 
 #include <stdlib.h>
+#include <sys/time.h>
+#include <sys/mman.h>
 // not available without support for C++0x
 // I could enable that, but I rather use the old, portable way.
 //#include <unordered_set>
@@ -128,12 +172,17 @@ void GetAbsoluteFilename(char *file)
 
 typedef std::set<void*> tmem;
 tmem temporary_memory;
+static QWORD temporary_bytes;
 
 void *AllocTemporary(int n) {
     void *p = MemAlloc(n);
     temporary_memory.insert(p);
+    temporary_bytes += n;
     return p;
 }
+QWORD TemporaryBytesAllocated(void) {
+    return temporary_bytes;
+}
 void FreeTemporary(void *p) {
     temporary_memory.erase(p);
     MemFree(p);
@@ -158,8 +207,9 @@ void *MemRealloc(void *p, int n) {
     if(!p2) oops();
     //TODO initialize additional memory with zeros
 
-    if (p != p2) {
-        temporary_memory.erase(p);
+    // Only temporary blocks are tracked; a permanent block that moved must
+    // not be added, or FreeAllTemporary would free it.
+    if (p != p2 && temporary_memory.erase(p)) {
         temporary_memory.insert(p2);
     }
 
@@ -174,6 +224,18 @@ void MemFree(void *p) {
     free(p);
 }
 
+void *AllocExecutable(int n) {
+    void *p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+                   -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+bool MakeExecutable(void *p, int n) {
+    return mprotect(p, n, PROT_READ | PROT_EXEC) == 0;
+}
+void FreeExecutable(void *p, int n) {
+    munmap(p, n);
+}
+
 void vl(void) {
     // we cannot validate resp. stdlib does it automatically at
     // appropriate times, if we have compiled it for debug
@@ -182,4 +244,18 @@ void vl(void) {
 void InitHeaps(void) {
 }
 
+SDWORD GetMilliseconds(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (SDWORD)((long long)tv.tv_sec*1000 + tv.tv_usec/1000);
+}
+
+SQWORD GetMicroseconds(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (SQWORD)tv.tv_sec*1000000 + tv.tv_usec;
+}
+
 #endif